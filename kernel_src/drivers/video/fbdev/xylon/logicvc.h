@@ -74,6 +74,11 @@
 #define LOGICVC_INT_L2_CLUT_SW		(1 << 10)
 #define LOGICVC_INT_L3_CLUT_SW		(1 << 11)
 #define LOGICVC_INT_L4_CLUT_SW		(1 << 12)
+#define LOGICVC_INT_CLUT_SW		(LOGICVC_INT_L0_CLUT_SW | \
+					 LOGICVC_INT_L1_CLUT_SW | \
+					 LOGICVC_INT_L2_CLUT_SW | \
+					 LOGICVC_INT_L3_CLUT_SW | \
+					 LOGICVC_INT_L4_CLUT_SW)
 
 /* logiCVC layer base offsets */
 #define LOGICVC_LAYER_OFFSET		0x80
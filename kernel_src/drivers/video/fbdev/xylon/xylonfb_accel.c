@@ -0,0 +1,505 @@
+/*
+ * Xylon logiCVC frame buffer driver drawing functions
+ *
+ * Copyright (C) 2016 Xylon d.o.o.
+ * Author: Davor Joja <davor.joja@logicbricks.com>
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * logiCVC video memory is mapped write combined. Writes are merged into
+ * bursts only if they are wide and sequential, and every read stalls until
+ * data arrives from memory. Drawing functions below write whole lines with
+ * aligned 32 bit stores, and read video memory only once per line into
+ * cached staging buffer. Unsupported cases fall back to cfb functions.
+ *
+ * If device tree provides DMA channel named "blit" with memcpy capability,
+ * large copies and fills are done with DMA, while CPU waits for DMA only
+ * when it accesses video memory next time. DMA is used only for layers in
+ * video memory given by device tree, which is mapped for DMA channel
+ * device. Layers in buffers allocated by driver are drawn by CPU.
+ */
+
+#include <linux/console.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+#include <linux/fb.h>
+#include <linux/io.h>
+#include <linux/kernel.h>
+
+#include "xylonfb_core.h"
+
+/* smaller rectangles are drawn faster by CPU than DMA setup takes */
+#define XYLONFB_ACCEL_DMA_MIN_LINE	256
+#define XYLONFB_ACCEL_DMA_MIN_SIZE	(32 * 1024)
+#define XYLONFB_ACCEL_DMA_TIMEOUT	1000
+
+static bool xylonfb_accel_bpp(u32 bpp)
+{
+	return (bpp == 8 || bpp == 16 || bpp == 32);
+}
+
+static u32 xylonfb_accel_color(struct fb_info *fbi, u32 color)
+{
+	if (fbi->fix.visual == FB_VISUAL_TRUECOLOR ||
+	    fbi->fix.visual == FB_VISUAL_DIRECTCOLOR)
+		return ((u32 *)fbi->pseudo_palette)[color];
+
+	return color;
+}
+
+static u32 xylonfb_accel_pattern(u32 color, u32 bpp)
+{
+	switch (bpp) {
+	case 8:
+		return (color & 0xFF) * 0x01010101;
+	case 16:
+		return (color & 0xFFFF) * 0x00010001;
+	default:
+		return color;
+	}
+}
+
+static void xylonfb_accel_fill_line(u8 __iomem *dst, u32 pattern, u32 len)
+{
+	if (((unsigned long)dst & 1) && len) {
+		fb_writeb((u8)pattern, dst);
+		dst++;
+		len--;
+	}
+	if (((unsigned long)dst & 2) && len >= 2) {
+		fb_writew((u16)pattern, dst);
+		dst += 2;
+		len -= 2;
+	}
+
+	for (; len >= 16; len -= 16, dst += 16) {
+		fb_writel(pattern, dst);
+		fb_writel(pattern, dst + 4);
+		fb_writel(pattern, dst + 8);
+		fb_writel(pattern, dst + 12);
+	}
+	for (; len >= 4; len -= 4, dst += 4)
+		fb_writel(pattern, dst);
+
+	if (len >= 2) {
+		fb_writew((u16)pattern, dst);
+		dst += 2;
+		len -= 2;
+	}
+	if (len)
+		fb_writeb((u8)pattern, dst);
+}
+
+static void xylonfb_accel_expand_line(void *dst, const u8 *src, u32 width,
+				      u32 fg, u32 bg, u32 bpp)
+{
+	u32 x;
+
+	switch (bpp) {
+	case 8:
+		for (x = 0; x < width; x++)
+			((u8 *)dst)[x] = (src[x >> 3] & (0x80 >> (x & 7))) ?
+					 fg : bg;
+		break;
+	case 16:
+		for (x = 0; x < width; x++)
+			((u16 *)dst)[x] = (src[x >> 3] & (0x80 >> (x & 7))) ?
+					  fg : bg;
+		break;
+	case 32:
+		for (x = 0; x < width; x++)
+			((u32 *)dst)[x] = (src[x >> 3] & (0x80 >> (x & 7))) ?
+					  fg : bg;
+		break;
+	}
+}
+
+static void xylonfb_accel_dma_callback(void *param)
+{
+	struct xylonfb_data *data = param;
+
+	wake_up_all(&data->blit_wait);
+}
+
+static bool xylonfb_accel_dma_done(struct dma_chan *chan, dma_cookie_t cookie)
+{
+	return (dma_async_is_tx_complete(chan, cookie, NULL, NULL) !=
+		DMA_IN_PROGRESS);
+}
+
+static dma_addr_t xylonfb_accel_dma_addr(struct fb_info *fbi, u8 __iomem *p)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+
+	return ld->accel_dma + (p - (u8 __iomem *)fbi->screen_base);
+}
+
+static int xylonfb_accel_dma_submit(struct xylonfb_data *data,
+				    dma_addr_t dst, dma_addr_t src,
+				    size_t size, bool last)
+{
+	struct dma_chan *chan = data->blit_chan;
+	struct dma_async_tx_descriptor *tx;
+	dma_cookie_t cookie;
+	unsigned long flags = DMA_CTRL_ACK;
+
+	if (last)
+		flags |= DMA_PREP_INTERRUPT;
+
+	tx = chan->device->device_prep_dma_memcpy(chan, dst, src, size, flags);
+	if (!tx)
+		return -ENOMEM;
+
+	if (last) {
+		tx->callback = xylonfb_accel_dma_callback;
+		tx->callback_param = data;
+	}
+
+	cookie = dmaengine_submit(tx);
+	if (dma_submit_error(cookie))
+		return -EIO;
+
+	data->blit_cookie = cookie;
+
+	return 0;
+}
+
+/*
+ * Copies lines in chunks, each chunk with single DMA transfer.
+ * Lines are contiguous in memory only if line length equals pitch, and
+ * then chunk is limited to the distance between source and destination
+ * lines, so no transfer overlaps itself. Transfers on a channel are done
+ * in submit order, so chunks are copied in the same order as by CPU.
+ * Returns number of lines copied, counting from src and dst.
+ */
+static u32 xylonfb_accel_dma_copy(struct fb_info *fbi, u8 __iomem *dst,
+				  u8 __iomem *src, u32 len, u32 height,
+				  long step, u32 chunk)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	struct xylonfb_data *data = ld->data;
+	unsigned long flags;
+	u32 y, n, top;
+	int ret = 0;
+
+	/* CPU writes must reach memory before DMA reads it */
+	wmb();
+
+	spin_lock_irqsave(&data->blit_lock, flags);
+	for (y = 0; y < height; y += n) {
+		n = min(chunk, height - y);
+		top = (step < 0) ? (y + n - 1) : y;
+		ret = xylonfb_accel_dma_submit(data,
+			xylonfb_accel_dma_addr(fbi, dst + ((long)top * step)),
+			xylonfb_accel_dma_addr(fbi, src + ((long)top * step)),
+			((n - 1) * abs(step)) + len, (y + n) == height);
+		if (ret)
+			break;
+	}
+	spin_unlock_irqrestore(&data->blit_lock, flags);
+
+	dma_async_issue_pending(data->blit_chan);
+
+	/* CPU completes the rest, after already submitted transfers */
+	if (ret)
+		dma_sync_wait(data->blit_chan, data->blit_cookie);
+
+	return y;
+}
+
+/*
+ * Replicates first line to following lines, doubling the chunk with each
+ * DMA transfer when lines are contiguous in memory.
+ * Returns number of lines filled, including the first line.
+ */
+static u32 xylonfb_accel_dma_fill(struct fb_info *fbi, u8 __iomem *dst,
+				  u32 len, u32 height)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	struct xylonfb_data *data = ld->data;
+	u32 pitch = fbi->fix.line_length;
+	unsigned long flags;
+	u32 y, n;
+	int ret = 0;
+
+	wmb();
+
+	spin_lock_irqsave(&data->blit_lock, flags);
+	for (y = 1; y < height; y += n) {
+		n = (len == pitch) ? min(y, height - y) : 1;
+		ret = xylonfb_accel_dma_submit(data,
+			xylonfb_accel_dma_addr(fbi, dst + (y * pitch)),
+			xylonfb_accel_dma_addr(fbi, dst),
+			((n - 1) * pitch) + len, (y + n) == height);
+		if (ret)
+			break;
+	}
+	spin_unlock_irqrestore(&data->blit_lock, flags);
+
+	dma_async_issue_pending(data->blit_chan);
+
+	if (ret)
+		dma_sync_wait(data->blit_chan, data->blit_cookie);
+
+	return y;
+}
+
+static bool xylonfb_accel_dma_use(struct fb_info *fbi, u32 len, u32 height)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+
+	return (ld->accel_dma && len >= XYLONFB_ACCEL_DMA_MIN_LINE &&
+		(len * height) >= XYLONFB_ACCEL_DMA_MIN_SIZE);
+}
+
+/*
+ * Waits for drawing DMA transfers to finish, before CPU accesses video
+ * memory. Drawing functions may be called from atomic context by console
+ * output, which cannot be detected reliably without preempt count, so
+ * they poll. Only callers known to run in process context sleep.
+ */
+void xylonfb_accel_sync(struct xylonfb_data *data, bool sleep)
+{
+	struct dma_chan *chan = data->blit_chan;
+	unsigned long flags;
+	dma_cookie_t cookie;
+
+	if (!chan)
+		return;
+
+	spin_lock_irqsave(&data->blit_lock, flags);
+	cookie = data->blit_cookie;
+	spin_unlock_irqrestore(&data->blit_lock, flags);
+
+	if (!cookie)
+		return;
+
+	if (!sleep) {
+		dma_sync_wait(chan, cookie);
+	} else if (!wait_event_timeout(data->blit_wait,
+			xylonfb_accel_dma_done(chan, cookie),
+			msecs_to_jiffies(XYLONFB_ACCEL_DMA_TIMEOUT))) {
+		dev_err(&data->pdev->dev, "failed wait drawing DMA\n");
+		dmaengine_terminate_all(chan);
+	}
+}
+
+int xylonfb_sync(struct fb_info *fbi)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+
+	xylonfb_accel_sync(ld->data, false);
+
+	return 0;
+}
+
+void xylonfb_accel_init(struct xylonfb_data *data)
+{
+	struct device *dev = &data->pdev->dev;
+	struct dma_chan *chan;
+
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	spin_lock_init(&data->blit_lock);
+	init_waitqueue_head(&data->blit_wait);
+
+	chan = dma_request_slave_channel(dev, "blit");
+	if (!chan)
+		return;
+
+	if (!dma_has_cap(DMA_MEMCPY, chan->device->cap_mask)) {
+		dev_warn(dev, "blit DMA channel without memcpy\n");
+		dma_release_channel(chan);
+		return;
+	}
+
+	data->blit_chan = chan;
+	dev_info(dev, "drawing with DMA\n");
+}
+
+void xylonfb_accel_map(struct fb_info *fbi)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	struct xylonfb_data *data = ld->data;
+	struct device *dma_dev;
+	dma_addr_t addr;
+
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	if (!data->blit_chan || !ld->fd->address)
+		return;
+
+	dma_dev = data->blit_chan->device->dev;
+	addr = dma_map_resource(dma_dev, ld->fb_pbase, ld->fb_size,
+				DMA_BIDIRECTIONAL, 0);
+	if (dma_mapping_error(dma_dev, addr)) {
+		dev_warn(&data->pdev->dev, "failed map ID%d for DMA\n",
+			 ld->fd->id);
+		return;
+	}
+
+	ld->accel_dma = addr;
+}
+
+void xylonfb_accel_deinit(struct xylonfb_data *data, struct fb_info **afbi)
+{
+	struct xylonfb_layer_data *ld;
+	int i;
+
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	if (!data->blit_chan)
+		return;
+
+	console_lock();
+	xylonfb_accel_sync(data, true);
+	for (i = 0; i < data->layers; i++) {
+		if (!afbi[i])
+			continue;
+		ld = afbi[i]->par;
+		if (!ld->accel_dma)
+			continue;
+		dma_unmap_resource(data->blit_chan->device->dev,
+				   ld->accel_dma, ld->fb_size,
+				   DMA_BIDIRECTIONAL, 0);
+		ld->accel_dma = 0;
+	}
+	dma_release_channel(data->blit_chan);
+	data->blit_chan = NULL;
+	console_unlock();
+}
+
+void xylonfb_fillrect(struct fb_info *fbi, const struct fb_fillrect *rect)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	u32 bpp = fbi->var.bits_per_pixel;
+	u32 pitch = fbi->fix.line_length;
+	u32 pattern, len, height;
+	u8 __iomem *dst;
+
+	xylonfb_accel_sync(ld->data, false);
+
+	if (rect->rop != ROP_COPY || !xylonfb_accel_bpp(bpp)) {
+		cfb_fillrect(fbi, rect);
+		return;
+	}
+
+	pattern = xylonfb_accel_pattern(xylonfb_accel_color(fbi, rect->color),
+					bpp);
+	dst = (u8 __iomem *)fbi->screen_base + (rect->dy * pitch) +
+	      (rect->dx * (bpp / 8));
+	len = rect->width * (bpp / 8);
+	height = rect->height;
+
+	if (height && xylonfb_accel_dma_use(fbi, len, height)) {
+		xylonfb_accel_fill_line(dst, pattern, len);
+		height -= xylonfb_accel_dma_fill(fbi, dst, len, height);
+		dst += (rect->height - height) * pitch;
+	}
+
+	for (; height; height--, dst += pitch)
+		xylonfb_accel_fill_line(dst, pattern, len);
+}
+
+void xylonfb_copyarea(struct fb_info *fbi, const struct fb_copyarea *area)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	u32 bpp = fbi->var.bits_per_pixel;
+	u32 pitch = fbi->fix.line_length;
+	u32 len = area->width * (bpp / 8);
+	u32 height = area->height;
+	u32 chunk, done;
+	u8 __iomem *src, *dst;
+	long step;
+
+	if (!xylonfb_accel_bpp(bpp) || len > ld->accel_line_size) {
+		xylonfb_accel_sync(ld->data, false);
+		cfb_copyarea(fbi, area);
+		return;
+	}
+
+	src = (u8 __iomem *)fbi->screen_base + (area->sy * pitch) +
+	      (area->sx * (bpp / 8));
+	dst = (u8 __iomem *)fbi->screen_base + (area->dy * pitch) +
+	      (area->dx * (bpp / 8));
+	step = pitch;
+
+	/* copy bottom-up if destination lines overlap source from below */
+	if (area->dy > area->sy && height) {
+		src += (height - 1) * pitch;
+		dst += (height - 1) * pitch;
+		step = -step;
+	}
+
+	/* DMA is not used if source and destination overlap within a line */
+	if (xylonfb_accel_dma_use(fbi, len, height) &&
+	    (area->dy != area->sy ||
+	     abs((int)area->dx - (int)area->sx) >= area->width)) {
+		if (len == pitch && area->dy != area->sy)
+			chunk = abs((int)area->dy - (int)area->sy);
+		else
+			chunk = 1;
+		done = xylonfb_accel_dma_copy(fbi, dst, src, len, height,
+					      step, chunk);
+		if (done == height)
+			return;
+		src += (long)done * step;
+		dst += (long)done * step;
+		height -= done;
+	}
+
+	xylonfb_accel_sync(ld->data, false);
+
+	/*
+	 * Each source line is read into cached memory first, which also
+	 * handles horizontal overlap of source and destination
+	 */
+	for (; height; height--) {
+		memcpy_fromio(ld->accel_line, src, len);
+		memcpy_toio(dst, ld->accel_line, len);
+		src += step;
+		dst += step;
+	}
+}
+
+void xylonfb_imageblit(struct fb_info *fbi, const struct fb_image *image)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	u32 bpp = fbi->var.bits_per_pixel;
+	u32 pitch = fbi->fix.line_length;
+	u32 len = image->width * (bpp / 8);
+	u32 spitch = (image->width + 7) / 8;
+	u32 fg, bg, height;
+	const u8 *src = (const u8 *)image->data;
+	u8 __iomem *dst;
+
+	xylonfb_accel_sync(ld->data, false);
+
+	if (image->depth != 1 || !xylonfb_accel_bpp(bpp) ||
+	    len > ld->accel_line_size) {
+		cfb_imageblit(fbi, image);
+		return;
+	}
+
+	fg = xylonfb_accel_color(fbi, image->fg_color);
+	bg = xylonfb_accel_color(fbi, image->bg_color);
+	dst = (u8 __iomem *)fbi->screen_base + (image->dy * pitch) +
+	      (image->dx * (bpp / 8));
+
+	for (height = image->height; height; height--) {
+		xylonfb_accel_expand_line(ld->accel_line, src, image->width,
+					  fg, bg, bpp);
+		memcpy_toio(dst, ld->accel_line, len);
+		src += spitch;
+		dst += pitch;
+	}
+}
@@ -206,6 +206,10 @@ static int xylonfb_adv7511_update(struct fb_info *fbi)
 
 	console_lock();
 
+	mutex_lock(&ld->data->vmode_mutex);
+	xylonfb_mode_update(ld->data, &fbi->monspecs);
+	mutex_unlock(&ld->data->vmode_mutex);
+
 	misc->var_screeninfo->xres_virtual = fbi->var.xres_virtual;
 	misc->var_screeninfo->yres_virtual = fbi->var.yres_virtual;
 	misc->var_screeninfo->xoffset = fbi->var.xoffset;
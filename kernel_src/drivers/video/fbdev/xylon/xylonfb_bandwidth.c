@@ -0,0 +1,128 @@
+/*
+ * Xylon logiCVC frame buffer driver memory bandwidth model
+ *
+ * Copyright (C) 2016 Xylon d.o.o.
+ * Author: Davor Joja <davor.joja@logicbricks.com>
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * logiCVC layer reads its visible part of a line from video memory during
+ * one line time, so the layer memory read rate is
+ *   width * bytes per pixel * pixel clock / horizontal total
+ * Layers may overlap on the same lines, so rates of all enabled layers
+ * are summed and compared with "memory-bandwidth" budget.
+ */
+
+#include <linux/device.h>
+#include <linux/fb.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+
+#include "logicvc.h"
+#include "xylonfb_core.h"
+
+/* Returns visible layer width for given horizontal resolution */
+u32 xylonfb_bw_layer_width(struct xylonfb_layer_data *ld, u32 xres)
+{
+	struct xylonfb_data *data = ld->data;
+	u32 width;
+
+	if (!(data->flags & XYLONFB_FLAGS_SIZE_POSITION))
+		return xres;
+
+	/* size register not written yet means full size layer */
+	width = data->reg_access.get_reg_val(ld->base,
+					     LOGICVC_LAYER_HSIZE_ROFF, ld);
+	if (!width)
+		return xres;
+
+	return min(width + 1, xres);
+}
+
+/* Returns layer memory read rate in bytes per second */
+u64 xylonfb_bw_layer(struct xylonfb_layer_data *ld,
+		     const struct fb_var_screeninfo *var, u32 width)
+{
+	u32 htotal = var->xres + var->left_margin + var->right_margin +
+		     var->hsync_len;
+
+	if (!var->pixclock || !htotal)
+		return 0;
+
+	return div_u64((u64)width * (ld->fd->bpp / 8) *
+		       PICOS2KHZ(var->pixclock) * 1000, htotal);
+}
+
+/*
+ * Returns memory read rate of all enabled layers with given timings.
+ * Layer ld is accounted as enabled with given width, or with its
+ * current width if width is 0.
+ */
+u64 xylonfb_bw_demand(struct xylonfb_data *data,
+		      const struct fb_var_screeninfo *var,
+		      struct xylonfb_layer_data *ld, u32 width)
+{
+	struct fb_info **afbi = dev_get_drvdata(&data->pdev->dev);
+	struct xylonfb_layer_data *l;
+	u64 demand = 0;
+	u32 w;
+	int i;
+
+	if (!afbi)
+		return 0;
+
+	for (i = 0; i < data->layers; i++) {
+		l = afbi[i]->par;
+		if ((l != ld) && !(l->flags & XYLONFB_FLAGS_LAYER_ENABLED))
+			continue;
+
+		if ((l == ld) && width)
+			w = min(width, var->xres);
+		else
+			w = xylonfb_bw_layer_width(l, var->xres);
+		demand += xylonfb_bw_layer(l, var, w);
+	}
+
+	return demand;
+}
+
+/*
+ * Checks if layer configuration fits memory bandwidth budget, with
+ * layer of fbi enabled with given width. Rejection is reported with
+ * warning only when layer is being enabled or resized, as screen info
+ * checks are also done for testing and probing of modes.
+ */
+int xylonfb_bw_check(struct fb_info *fbi, const struct fb_var_screeninfo *var,
+		     u32 width, bool warn)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	struct xylonfb_data *data = ld->data;
+	u64 demand;
+
+	if (!data->mem_bw)
+		return 0;
+
+	demand = xylonfb_bw_demand(data, var, ld, width);
+	if (demand > ((u64)data->mem_bw * 1000000)) {
+		if (warn)
+			dev_warn(fbi->dev,
+				 "insufficient memory bandwidth %llu MB/s of %u MB/s\n",
+				 div_u64(demand, 1000000), data->mem_bw);
+		else
+			dev_dbg(fbi->dev,
+				"insufficient memory bandwidth %llu MB/s of %u MB/s\n",
+				div_u64(demand, 1000000), data->mem_bw);
+		return -EINVAL;
+	}
+
+	return 0;
+}
@@ -0,0 +1,225 @@
+/*
+ * Xylon logiCVC frame buffer driver configuration test
+ *
+ * Copyright (C) 2016 Xylon d.o.o.
+ * Author: Davor Joja <davor.joja@logicbricks.com>
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Configurations are checked against driver and logiCVC limits only,
+ * without register access or memory allocation, so display managers can
+ * probe many candidate configurations cheaply.
+ * Unlike xylonfb_check_var(), nothing is adjusted: configuration either
+ * works as requested or is rejected.
+ */
+
+#include <linux/device.h>
+#include <linux/fb.h>
+#include <linux/kernel.h>
+#include <uapi/linux/xylonfb.h>
+
+#include "logicvc.h"
+#include "xylonfb_core.h"
+
+static u32 xylonfb_config_test_timings(struct xylonfb_data *data,
+				       const struct fb_var_screeninfo *var)
+{
+	u32 fail = 0;
+
+	/* timing registers are written with value - 1 */
+	if (!var->pixclock ||
+	    !var->left_margin || !var->right_margin || !var->hsync_len ||
+	    !var->upper_margin || !var->lower_margin || !var->vsync_len)
+		fail |= XYLONFB_CONFIG_FAIL_TIMINGS;
+
+	if ((var->xres < LOGICVC_MIN_XRES) || (var->xres > data->max_h_res) ||
+	    (var->yres < LOGICVC_MIN_VRES) || (var->yres > data->max_v_res))
+		fail |= XYLONFB_CONFIG_FAIL_RESOLUTION;
+
+	return fail;
+}
+
+/*
+ * Pixel clock passes if timings fitted to achievable clock frequency, the
+ * same way mode set fits them, keep refresh rate in Hz of requested ones.
+ * Refresh rate of fitted timings is returned in mHz, 0 if not achievable.
+ */
+static u32 xylonfb_config_test_pixclk(struct xylonfb_data *data,
+				      const struct fb_var_screeninfo *var,
+				      u32 *refresh_mhz)
+{
+	struct fb_videomode vm;
+	unsigned long pixclk_khz, round_khz;
+	u32 htotal, vtotal;
+	int ret = -ENODEV;
+
+	*refresh_mhz = 0;
+
+	if (!var->pixclock)
+		return XYLONFB_CONFIG_FAIL_PIXCLK;
+
+	pixclk_khz = PICOS2KHZ(var->pixclock);
+	if (data->flags & XYLONFB_FLAGS_PIXCLK_VALID)
+		ret = xylonfb_hw_pixclk_round(data, pixclk_khz, &round_khz);
+	/* without pixel clock control only active frequency is available */
+	if (ret == -ENODEV)
+		round_khz = PICOS2KHZ(data->vm_active.vmode.pixclock);
+	else if (ret || !round_khz)
+		return XYLONFB_CONFIG_FAIL_PIXCLK;
+
+	fb_var_to_videomode(&vm, var);
+	*refresh_mhz = xylonfb_mode_fit(&vm, round_khz, &htotal, &vtotal);
+	if (DIV_ROUND_CLOSEST(*refresh_mhz, 1000) !=
+	    xylonfb_mode_var_refresh(var))
+		return XYLONFB_CONFIG_FAIL_PIXCLK;
+
+	return 0;
+}
+
+static bool xylonfb_config_bitfield(const struct fb_bitfield *a,
+				    const struct fb_bitfield *b)
+{
+	return ((a->offset == b->offset) && (a->length == b->length) &&
+		(a->msb_right == b->msb_right));
+}
+
+/* Strict check of var used with FB_ACTIVATE_TEST */
+int xylonfb_config_test_var(struct fb_info *fbi,
+			    const struct fb_var_screeninfo *var)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	struct xylonfb_layer_fix_data *fd = ld->fd;
+	struct xylonfb_data *data = ld->data;
+	u32 fail, height, refresh_mhz;
+
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	fail = xylonfb_config_test_timings(data, var);
+	fail |= xylonfb_config_test_pixclk(data, var, &refresh_mhz);
+
+	if (fd->buffer_offset && (var->yres > fd->buffer_offset))
+		fail |= XYLONFB_CONFIG_FAIL_MEMORY;
+
+	height = min(xylonfb_get_buffer_lines(fd, var->yres) * ld->buffers,
+		     fd->height);
+	if ((var->xres_virtual < var->xres) ||
+	    (var->xres_virtual > fd->width) ||
+	    (var->yres_virtual < var->yres) ||
+	    (var->yres_virtual > height))
+		fail |= XYLONFB_CONFIG_FAIL_MEMORY;
+
+	if (((var->xoffset + var->xres) > var->xres_virtual) ||
+	    ((var->yoffset + var->yres) > var->yres_virtual) ||
+	    (xylonfb_get_format(fd->format)->yuv422 && (var->xoffset & 1)))
+		fail |= XYLONFB_CONFIG_FAIL_GEOMETRY;
+
+	/* pixel format is fixed by layer, xylonfb_check_var() sets it */
+	if ((var->bits_per_pixel != fbi->var.bits_per_pixel) ||
+	    (var->grayscale != fbi->var.grayscale) ||
+	    !xylonfb_config_bitfield(&var->red, &fbi->var.red) ||
+	    !xylonfb_config_bitfield(&var->green, &fbi->var.green) ||
+	    !xylonfb_config_bitfield(&var->blue, &fbi->var.blue) ||
+	    !xylonfb_config_bitfield(&var->transp, &fbi->var.transp))
+		fail |= XYLONFB_CONFIG_FAIL_BPP;
+
+	if (fail) {
+		XYLONFB_DBG(INFO, "%s failed 0x%x", __func__, fail);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static u32 xylonfb_config_test_layer(struct fb_info *fbi,
+				     const struct fb_var_screeninfo *var,
+				     const struct xylonfb_config_layer *layer,
+				     u32 *width)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	struct xylonfb_layer_fix_data *fd = ld->fd;
+	struct xylonfb_data *data = ld->data;
+	u32 w, h, buffers;
+	u32 fail = 0;
+
+	w = layer->width ? layer->width : var->xres;
+	h = layer->height ? layer->height : var->yres;
+
+	if (((layer->x + w) > var->xres) || ((layer->y + h) > var->yres) ||
+	    (w > fd->width) ||
+	    (xylonfb_get_format(fd->format)->yuv422 && (w & 1)))
+		fail |= XYLONFB_CONFIG_FAIL_GEOMETRY;
+	if ((layer->x || layer->y || (w != var->xres) || (h != var->yres)) &&
+	    !(data->flags & XYLONFB_FLAGS_SIZE_POSITION))
+		fail |= XYLONFB_CONFIG_FAIL_GEOMETRY;
+
+	if (layer->bits_per_pixel &&
+	    (layer->bits_per_pixel != fbi->var.bits_per_pixel))
+		fail |= XYLONFB_CONFIG_FAIL_BPP;
+
+	buffers = layer->buffers ? layer->buffers : ld->buffers;
+	if ((buffers > XYLONFB_MAX_LAYER_BUFFERS) ||
+	    (fd->buffer_offset && (var->yres > fd->buffer_offset)) ||
+	    ((xylonfb_get_buffer_lines(fd, var->yres) * buffers) > fd->height))
+		fail |= XYLONFB_CONFIG_FAIL_MEMORY;
+
+	*width = min(w, var->xres);
+
+	return fail;
+}
+
+/* Checks complete configuration of all device layers */
+int xylonfb_config_test(struct fb_info *fbi, struct xylonfb_config *config)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	struct xylonfb_data *data = ld->data;
+	struct fb_info **afbi = dev_get_drvdata(fbi->device);
+	struct fb_var_screeninfo var;
+	u64 demand = 0;
+	u32 fail, width;
+	int i;
+
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	memset(&var, 0, sizeof(var));
+	var.pixclock = config->pixclock;
+	var.xres = config->xres;
+	var.yres = config->yres;
+	var.left_margin = config->left_margin;
+	var.right_margin = config->right_margin;
+	var.upper_margin = config->upper_margin;
+	var.lower_margin = config->lower_margin;
+	var.hsync_len = config->hsync_len;
+	var.vsync_len = config->vsync_len;
+
+	fail = xylonfb_config_test_timings(data, &var);
+	fail |= xylonfb_config_test_pixclk(data, &var, &config->refresh_mhz);
+
+	for (i = 0; i < XYLONFB_CONFIG_MAX_LAYERS; i++) {
+		if (!config->layer[i].enable)
+			continue;
+		if (i >= data->layers) {
+			fail |= XYLONFB_CONFIG_FAIL_GEOMETRY;
+			continue;
+		}
+
+		fail |= xylonfb_config_test_layer(afbi[i], &var,
+						  &config->layer[i], &width);
+		demand += xylonfb_bw_layer(afbi[i]->par, &var, width);
+	}
+
+	if (data->mem_bw && (demand > ((u64)data->mem_bw * 1000000)))
+		fail |= XYLONFB_CONFIG_FAIL_BANDWIDTH;
+
+	config->fail = fail;
+
+	return fail ? -EINVAL : 0;
+}
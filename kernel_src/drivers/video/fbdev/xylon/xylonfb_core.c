@@ -15,38 +15,26 @@
  */
 
 #include <linux/console.h>
-#include <linux/delay.h>
 #include <linux/dma-mapping.h>
 #include <linux/interrupt.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/uaccess.h>
-#include <linux/videodev2.h>
+#include <uapi/linux/xylonfb.h>
 
 #include "xylonfb_core.h"
 #include "logicvc.h"
 
-#define LOGICVC_PIX_FMT_AYUV			v4l2_fourcc('A', 'Y', 'U', 'V')
-#define LOGICVC_PIX_FMT_AVUY			v4l2_fourcc('A', 'V', 'U', 'Y')
-#define LOGICVC_PIX_FMT_ALPHA			v4l2_fourcc('A', '8', ' ', ' ')
-/* Framebuffer v4 added YUV formats */
-#define LOGICVC_PIX_FMT_XYUV			v4l2_fourcc('X', 'Y', 'U', 'V')
-#define LOGICVC_PIX_FMT_XVUY			v4l2_fourcc('X', 'V', 'U', 'Y')
-#define LOGICVC_PIX_FMT_YUYV_121010		v4l2_fourcc('Y', 'U', '2', '0')
-#define LOGICVC_PIX_FMT_UYVY_121010		v4l2_fourcc('U', 'Y', '2', '0')
-#define LOGICVC_PIX_FMT_XYUV_2101010	v4l2_fourcc('X', 'Y', '3', '0')
-#define LOGICVC_PIX_FMT_XVUY_2101010	v4l2_fourcc('X', 'V', '3', '0')
-
 #define XYLONFB_PSEUDO_PALETTE_SIZE	256
 #define XYLONFB_VRES_DEFAULT		1080
+/* FIFO underrun interrupt is masked for this long after it comes */
+#define XYLONFB_UNDERRUN_REARM_MS	1000
 
 #define LOGICVC_COLOR_RGB_BLACK		0
 #define LOGICVC_COLOR_RGB_WHITE		0xFFFFFF
 #define LOGICVC_COLOR_YUV888_BLACK	0x8080
 #define LOGICVC_COLOR_YUV888_WHITE	0xFF8080
 
-char *xylonfb_mode_option;
-
 static const struct xylonfb_vmode xylonfb_vm = {
 	.vmode = {
 		.refresh = 60,
@@ -64,12 +52,17 @@ static const struct xylonfb_vmode xylonfb_vm = {
 	.name = "1024x768"
 };
 
+static u32 xylonfb_get_buffers_height(struct xylonfb_layer_data *ld,
+				      u32 yres);
 static int xylonfb_set_timings(struct fb_info *fbi, int bpp);
 static void xylonfb_logicvc_disp_ctrl(struct fb_info *fbi, bool enable);
 static void xylonfb_enable_logicvc_output(struct fb_info *fbi);
 static void xylonfb_disable_logicvc_output(struct fb_info *fbi);
 static void xylonfb_logicvc_layer_enable(struct fb_info *fbi, bool enable);
+static void xylonfb_logicvc_layer_blank(struct fb_info *fbi, bool blank);
 static void xylonfb_fbi_update(struct fb_info *fbi);
+static void xylonfb_set_fbi_var_screeninfo(struct fb_var_screeninfo *var,
+					   struct xylonfb_data *data);
 
 static unsigned long xylonfb_get_reg_mem_addr(void __iomem *base,
 					      unsigned int offset,
@@ -124,6 +117,48 @@ static void xylonfb_set_reg_mem(u32 value, void __iomem *base,
 	writel((*reg_mem_addr), (base + offset));
 }
 
+static void xylonfb_pan_regs(struct fb_info *fbi, u32 xoffset, u32 yoffset)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	struct xylonfb_data *data = ld->data;
+
+	if (!(data->flags & XYLONFB_FLAGS_DYNAMIC_LAYER_ADDRESS)) {
+		data->reg_access.set_reg_val(xoffset, ld->base,
+					     LOGICVC_LAYER_HOFF_ROFF, ld);
+		data->reg_access.set_reg_val(yoffset, ld->base,
+					     LOGICVC_LAYER_VOFF_ROFF, ld);
+	} else {
+		ld->fb_pbase_active = ld->fb_pbase +
+				      (xoffset * (ld->fd->bpp / 8)) +
+				      (yoffset * fbi->fix.line_length);
+		data->reg_access.set_reg_val(ld->fb_pbase_active, ld->base,
+					     LOGICVC_LAYER_ADDR_ROFF, ld);
+	}
+}
+
+/* Applies layer pans deferred to frame start */
+static void xylonfb_flip_apply(struct xylonfb_data *data)
+{
+	struct fb_info **afbi = dev_get_drvdata(&data->pdev->dev);
+	struct xylonfb_layer_data *ld;
+	unsigned long flags;
+	int i;
+
+	if (!afbi)
+		return;
+
+	spin_lock_irqsave(&data->flip_lock, flags);
+	for (i = 0; i < data->layers; i++) {
+		ld = afbi[i]->par;
+		if (!ld->flip_pending)
+			continue;
+
+		xylonfb_pan_regs(afbi[i], ld->flip_xoffset, ld->flip_yoffset);
+		ld->flip_pending = false;
+	}
+	spin_unlock_irqrestore(&data->flip_lock, flags);
+}
+
 static irqreturn_t xylonfb_isr(int irq, void *dev_id)
 {
 	struct fb_info **afbi = dev_get_drvdata(dev_id);
@@ -131,21 +166,102 @@ static irqreturn_t xylonfb_isr(int irq, void *dev_id)
 	struct xylonfb_layer_data *ld = fbi->par;
 	struct xylonfb_data *data = ld->data;
 	void __iomem *dev_base = data->dev_base;
-	u32 isr;
+	irqreturn_t ret = IRQ_NONE;
+	u32 isr, imr;
+	int i;
 
 	isr = readl(dev_base + LOGICVC_INT_STAT_ROFF);
 	if (isr & LOGICVC_INT_V_SYNC) {
 		writel(LOGICVC_INT_V_SYNC, dev_base + LOGICVC_INT_STAT_ROFF);
 
 		data->vsync.count++;
+		if (data->vm_active.vmode.vmode & FB_VMODE_INTERLACED)
+			data->vsync.field ^= 1;
+		/* frame starts with top field, so flips never split a frame */
+		if (data->vsync.field == XYLONFB_FIELD_TOP)
+			xylonfb_flip_apply(data);
 
 		if (waitqueue_active(&data->vsync.wait))
 			wake_up_interruptible(&data->vsync.wait);
 
-		return IRQ_HANDLED;
+		ret = IRQ_HANDLED;
+	}
+
+	if (isr & LOGICVC_INT_FIFO_UNDERRUN) {
+		writel(LOGICVC_INT_FIFO_UNDERRUN,
+		       dev_base + LOGICVC_INT_STAT_ROFF);
+
+		atomic_inc(&data->underruns);
+
+		/* underrun repeats every line, so it is reported rarely */
+		spin_lock(&data->irq_lock);
+		imr = data->reg_access.get_reg_val(dev_base,
+						   LOGICVC_INT_MASK_ROFF, ld);
+		if (!(imr & LOGICVC_INT_FIFO_UNDERRUN)) {
+			data->reg_access.set_reg_val(imr |
+						     LOGICVC_INT_FIFO_UNDERRUN,
+						     dev_base,
+						     LOGICVC_INT_MASK_ROFF, ld);
+			if (data->underrun_rearm)
+				schedule_delayed_work(&data->underrun_work,
+					msecs_to_jiffies(
+						XYLONFB_UNDERRUN_REARM_MS));
+			dev_warn_ratelimited(&data->pdev->dev,
+					     "FIFO underrun\n");
+		}
+		spin_unlock(&data->irq_lock);
+
+		ret = IRQ_HANDLED;
+	}
+
+	if (isr & LOGICVC_INT_CLUT_SW) {
+		writel((isr & LOGICVC_INT_CLUT_SW),
+		       dev_base + LOGICVC_INT_STAT_ROFF);
+
+		spin_lock(&data->clut_lock);
+		for (i = 0; i < data->layers; i++) {
+			if (!(isr & (LOGICVC_INT_L0_CLUT_SW << i)))
+				continue;
+			ld = afbi[i]->par;
+			if (ld->clut.switching) {
+				ld->clut.bank ^= 1;
+				ld->clut.switching = false;
+			}
+		}
+		spin_unlock(&data->clut_lock);
+
+		wake_up(&data->clut_wait);
+
+		ret = IRQ_HANDLED;
 	}
 
-	return IRQ_NONE;
+	return ret;
+}
+
+static void xylonfb_underrun_work(struct work_struct *work)
+{
+	struct xylonfb_data *data = container_of(to_delayed_work(work),
+						 struct xylonfb_data,
+						 underrun_work);
+	struct fb_info **afbi = dev_get_drvdata(&data->pdev->dev);
+	struct xylonfb_layer_data *ld = afbi[0]->par;
+	void __iomem *dev_base = data->dev_base;
+	unsigned long flags;
+	u32 imr;
+
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	spin_lock_irqsave(&data->irq_lock, flags);
+	if (data->underrun_rearm) {
+		writel(LOGICVC_INT_FIFO_UNDERRUN,
+		       dev_base + LOGICVC_INT_STAT_ROFF);
+		imr = data->reg_access.get_reg_val(dev_base,
+						   LOGICVC_INT_MASK_ROFF, ld);
+		data->reg_access.set_reg_val(imr & ~LOGICVC_INT_FIFO_UNDERRUN,
+					     dev_base, LOGICVC_INT_MASK_ROFF,
+					     ld);
+	}
+	spin_unlock_irqrestore(&data->irq_lock, flags);
 }
 
 static int xylonfb_open(struct fb_info *fbi, int user)
@@ -177,6 +293,9 @@ static int xylonfb_open(struct fb_info *fbi, int user)
 		}
 
 		if (enable) {
+			ret = xylonfb_bw_check(fbi, &fbi->var, 0, true);
+			if (ret)
+				return ret;
 			xylonfb_logicvc_layer_enable(fbi, true);
 			atomic_inc(&data->refcount);
 		}
@@ -212,9 +331,17 @@ static int xylonfb_check_var(struct fb_var_screeninfo *var,
 	struct xylonfb_layer_data *ld = fbi->par;
 	struct xylonfb_layer_fix_data *fd = ld->fd;
 	struct xylonfb_data *data = ld->data;
+	int ret;
 
 	XYLONFB_DBG(INFO, "%s", __func__);
 
+	/* test request is rejected instead of adjusted */
+	if ((var->activate & FB_ACTIVATE_MASK) == FB_ACTIVATE_TEST) {
+		ret = xylonfb_config_test_var(fbi, var);
+		if (ret)
+			return ret;
+	}
+
 	if (var->xres < LOGICVC_MIN_XRES)
 		var->xres = LOGICVC_MIN_XRES;
 	if (var->xres > data->max_h_res)
@@ -234,20 +361,17 @@ static int xylonfb_check_var(struct fb_var_screeninfo *var,
 		var->xres_virtual = fd->width;
 	if (var->yres_virtual < var->yres)
 		var->yres_virtual = var->yres;
-	if (var->yres_virtual > fd->height)
-		var->yres_virtual = fd->height;
+	if (var->yres_virtual > xylonfb_get_buffers_height(ld, var->yres))
+		var->yres_virtual = xylonfb_get_buffers_height(ld, var->yres);
 
 	/* YUV 4:2:2 layer type can only have even layer xoffset */
-	if (fd->format == XYLONFB_FORMAT_YUYV ||
-		fd->format == XYLONFB_FORMAT_UYVY ||
-		fd->format == XYLONFB_FORMAT_YUYV_121010 ||
-		fd->format == XYLONFB_FORMAT_UYVY_121010)
+	if (xylonfb_get_format(fd->format)->yuv422)
 		var->xoffset &= ~((unsigned long) + 1);
 
-	if ((var->xoffset + var->xres) >= var->xres_virtual)
-		var->xoffset = var->xres_virtual - var->xres - 1;
-	if ((var->yoffset + var->yres) >= var->yres_virtual)
-		var->yoffset = var->yres_virtual - var->yres - 1;
+	if ((var->xoffset + var->xres) > var->xres_virtual)
+		var->xoffset = var->xres_virtual - var->xres;
+	if ((var->yoffset + var->yres) > var->yres_virtual)
+		var->yoffset = var->yres_virtual - var->yres;
 
 	if (var->bits_per_pixel != fbi->var.bits_per_pixel) {
 		if (var->bits_per_pixel == 24)
@@ -275,10 +399,231 @@ static int xylonfb_check_var(struct fb_var_screeninfo *var,
 	var->sync = fbi->var.sync;
 	var->rotate = fbi->var.rotate;
 
+	return xylonfb_bw_check(fbi, var, 0, false);
+}
+
+/* Interlaced video mode vertical timings are programmed per field */
+static u32 xylonfb_field_lines(struct fb_videomode *vm, u32 lines)
+{
+	if (vm->vmode & FB_VMODE_INTERLACED)
+		return lines / 2;
+
+	return lines;
+}
+
+/*
+ * Checks if logiCVC is already running in active video mode,
+ * set up by bootloader
+ */
+static bool xylonfb_handoff_timings(struct xylonfb_data *data)
+{
+	void __iomem *dev_base = data->dev_base;
+	struct fb_videomode *vm = &data->vm_active.vmode;
+
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	return ((readl(dev_base + LOGICVC_HSYNC_FRONT_PORCH_ROFF) ==
+		 (vm->right_margin - 1)) &&
+		(readl(dev_base + LOGICVC_HSYNC_ROFF) ==
+		 (vm->hsync_len - 1)) &&
+		(readl(dev_base + LOGICVC_HSYNC_BACK_PORCH_ROFF) ==
+		 (vm->left_margin - 1)) &&
+		(readl(dev_base + LOGICVC_HRES_ROFF) ==
+		 (vm->xres - 1)) &&
+		(readl(dev_base + LOGICVC_VSYNC_FRONT_PORCH_ROFF) ==
+		 (xylonfb_field_lines(vm, vm->lower_margin) - 1)) &&
+		(readl(dev_base + LOGICVC_VSYNC_ROFF) ==
+		 (xylonfb_field_lines(vm, vm->vsync_len) - 1)) &&
+		(readl(dev_base + LOGICVC_VSYNC_BACK_PORCH_ROFF) ==
+		 (xylonfb_field_lines(vm, vm->upper_margin) - 1)) &&
+		(readl(dev_base + LOGICVC_VRES_ROFF) ==
+		 (xylonfb_field_lines(vm, vm->yres) - 1)) &&
+		(readl(dev_base + LOGICVC_CTRL_ROFF) == data->vm_active.ctrl));
+}
+
+/*
+ * Handed off mode keeps timings programmed by bootloader, so pixel clock
+ * and refresh rate are taken from them instead of being fitted.
+ */
+static void xylonfb_handoff_rate(struct xylonfb_data *data)
+{
+	struct fb_videomode *vm = &data->vm_active.vmode;
+	unsigned long pixclk_khz = PICOS2KHZ(vm->pixclock);
+	u32 htotal, vtotal;
+
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	if ((data->flags & XYLONFB_FLAGS_PIXCLK_VALID) &&
+	    data->pixel_clock.rate_khz)
+		pixclk_khz = data->pixel_clock.rate_khz;
+
+	htotal = vm->xres + vm->left_margin + vm->right_margin +
+		 vm->hsync_len;
+	vtotal = vm->yres + vm->upper_margin + vm->lower_margin +
+		 vm->vsync_len;
+
+	data->vm_active.pixclk_khz = pixclk_khz;
+	data->vm_active.refresh_mhz = div64_u64((u64)pixclk_khz * 1000000,
+						(u64)htotal * vtotal);
+}
+
+/*
+ * Compares video modes, so mode set applies only what has changed.
+ * Resolution and polarity changes need output off, while porches, sync
+ * lengths and pixel clock, i.e. refresh rate, are changed with output
+ * running.
+ */
+static u32 xylonfb_vmode_diff(struct xylonfb_vmode *old,
+			      struct xylonfb_vmode *new)
+{
+	struct fb_videomode *o = &old->vmode;
+	struct fb_videomode *n = &new->vmode;
+	u32 diff = 0;
+
+	if ((o->pixclock != n->pixclock) ||
+	    (old->pixclk_khz != new->pixclk_khz))
+		diff |= XYLONFB_VMODE_DIFF_PIXCLK;
+
+	if ((o->left_margin != n->left_margin) ||
+	    (o->right_margin != n->right_margin) ||
+	    (o->upper_margin != n->upper_margin) ||
+	    (o->lower_margin != n->lower_margin) ||
+	    (o->hsync_len != n->hsync_len) ||
+	    (o->vsync_len != n->vsync_len))
+		diff |= XYLONFB_VMODE_DIFF_PORCHES;
+
+	if ((o->xres != n->xres) || (o->yres != n->yres) ||
+	    ((o->vmode ^ n->vmode) & FB_VMODE_INTERLACED) ||
+	    (old->ctrl != new->ctrl))
+		diff |= XYLONFB_VMODE_DIFF_TIMINGS;
+
+	return diff;
+}
+
+/* Fits active video mode to pixel clock frequency the clock can generate */
+static void xylonfb_vmode_fit(struct fb_info *fbi)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	struct xylonfb_data *data = ld->data;
+	struct fb_videomode *vm = &data->vm_active.vmode;
+	unsigned long pixclk_khz, round_khz;
+	u32 htotal, vtotal, h, v, refresh_mhz;
+
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	pixclk_khz = PICOS2KHZ(vm->pixclock);
+	htotal = vm->xres + vm->left_margin + vm->right_margin +
+		 vm->hsync_len;
+	vtotal = vm->yres + vm->upper_margin + vm->lower_margin +
+		 vm->vsync_len;
+
+	if (!(data->flags & XYLONFB_FLAGS_PIXCLK_VALID) ||
+	    xylonfb_hw_pixclk_round(data, pixclk_khz, &round_khz) ||
+	    !round_khz)
+		round_khz = pixclk_khz;
+
+	refresh_mhz = xylonfb_mode_fit(vm, round_khz, &h, &v);
+
+	vm->right_margin += h - htotal;
+	vm->lower_margin += v - vtotal;
+	if (round_khz != pixclk_khz)
+		vm->pixclock = KHZ2PICOS(round_khz);
+
+	data->vm_active.pixclk_khz = round_khz;
+	data->vm_active.refresh_mhz = refresh_mhz;
+
+	if (round_khz != pixclk_khz)
+		dev_info(fbi->dev,
+			 "pixel clock %lu kHz, front porches %u %u, refresh %u.%03u Hz\n",
+			 round_khz, vm->right_margin, vm->lower_margin,
+			 data->vm_active.refresh_mhz / 1000,
+			 data->vm_active.refresh_mhz % 1000);
+}
+
+/*
+ * Writes porches and sync lengths right after V sync, so the frame being
+ * scanned out is not changed, with layers and display power left on.
+ * Pixel clock is changed right after them, in the same blanking interval
+ * only if the clock provider does not sleep, so a display may see one
+ * frame with old porches at new pixel clock. Nothing is changed if V sync
+ * is not signaled while output is on.
+ */
+static int xylonfb_set_porches_seamless(struct fb_info *fbi, u32 diff)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	struct xylonfb_data *data = ld->data;
+	void __iomem *dev_base = data->dev_base;
+	struct fb_videomode *vm = &data->vm_active.vmode;
+	bool vsync_irq;
+	int ret = 0;
+
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	/* frames are not scanned out without display signals */
+	if (data->pwr_state >= XYLONFB_POWER_SIGNAL) {
+		vsync_irq = !(data->reg_access.get_reg_val(dev_base,
+							   LOGICVC_INT_MASK_ROFF,
+							   ld) &
+			      LOGICVC_INT_V_SYNC);
+		if (!vsync_irq)
+			xylonfb_vsync_ctrl(fbi, true);
+
+		ret = xylonfb_vsync_wait(0, fbi);
+
+		if (!vsync_irq)
+			xylonfb_vsync_ctrl(fbi, false);
+
+		if (ret) {
+			dev_err(fbi->dev, "failed wait V sync\n");
+			return ret;
+		}
+	}
+
+	if (diff & XYLONFB_VMODE_DIFF_PORCHES) {
+		writel(vm->right_margin - 1,
+		       dev_base + LOGICVC_HSYNC_FRONT_PORCH_ROFF);
+		writel(vm->hsync_len - 1, dev_base + LOGICVC_HSYNC_ROFF);
+		writel(vm->left_margin - 1,
+		       dev_base + LOGICVC_HSYNC_BACK_PORCH_ROFF);
+		writel(xylonfb_field_lines(vm, vm->lower_margin) - 1,
+		       dev_base + LOGICVC_VSYNC_FRONT_PORCH_ROFF);
+		writel(xylonfb_field_lines(vm, vm->vsync_len) - 1,
+		       dev_base + LOGICVC_VSYNC_ROFF);
+		writel(xylonfb_field_lines(vm, vm->upper_margin) - 1,
+		       dev_base + LOGICVC_VSYNC_BACK_PORCH_ROFF);
+	}
+
+	if ((diff & XYLONFB_VMODE_DIFF_PIXCLK) &&
+	    (data->flags & XYLONFB_FLAGS_PIXCLK_VALID) &&
+	    xylonfb_hw_pixclk_set(data, data->vm_active.pixclk_khz))
+		dev_err(fbi->dev, "failed set pixel clock\n");
+
 	return 0;
 }
 
-static int xylonfb_set_par(struct fb_info *fbi)
+/* Activates video mode found in video mode index */
+static void xylonfb_set_vmode_active(struct xylonfb_data *data,
+				     const struct xylonfb_mode *mode, int bpp)
+{
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	data->vm_active.ctrl = data->vm.ctrl;
+	data->vm_active.vmode = mode->vmode;
+	strcpy(data->vm_active.opts_cvt, data->vm.opts_cvt);
+	strcpy(data->vm_active.opts_ext, data->vm.opts_ext);
+	sprintf(data->vm_active.name, "%dx%d%s-%d@%d%s",
+		mode->vmode.xres, mode->vmode.yres,
+		data->vm_active.opts_cvt, bpp,
+		data->vm_active.vmode.refresh,
+		data->vm_active.opts_ext);
+
+	if ((data->flags & XYLONFB_FLAGS_EDID_READY) ||
+	    !memchr(data->vm.name, 'x', 10))
+		data->vm = data->vm_active;
+}
+
+/* Called with vmode_mutex held */
+static int xylonfb_set_vmode(struct fb_info *fbi)
 {
 	struct device *dev = fbi->dev;
 	struct fb_info **afbi = NULL;
@@ -287,8 +632,10 @@ static int xylonfb_set_par(struct fb_info *fbi)
 	unsigned long f;
 	int i, bpp;
 	int ret = 0;
-	char vmode_opt[VMODE_NAME_SIZE];
-	bool resolution_change, layer_on[LOGICVC_MAX_LAYERS];
+	struct xylonfb_vmode vm_old;
+	const struct xylonfb_mode *mode;
+	u32 diff, mode_flags, refresh, interlaced;
+	bool vmode_change, layer_on[LOGICVC_MAX_LAYERS];
 
 	XYLONFB_DBG(INFO, "%s", __func__);
 
@@ -299,35 +646,131 @@ static int xylonfb_set_par(struct fb_info *fbi)
 		fbi->var.upper_margin, fbi->var.lower_margin,
 		fbi->var.hsync_len, fbi->var.vsync_len);
 
+	fbi->fix.smem_len = fbi->fix.line_length *
+			    xylonfb_get_buffers_height(ld, fbi->var.yres);
+
 	if (data->flags & XYLONFB_FLAGS_VMODE_SET)
 		return 0;
 
-	/* check if params changed */
-		resolution_change = true;
+	/* check if resolution, refresh rate or exact timings changed */
+	vmode_change = true;
+	refresh = xylonfb_mode_var_refresh(&fbi->var);
 	if (!(data->flags & XYLONFB_FLAGS_EDID_VMODE)) {
 		struct fb_videomode *vmact = &data->vm_active.vmode;
+
 		if (data->flags & XYLONFB_FLAGS_PUT_VSCREENINFO_EXACT) {
 			if ((fbi->var.xres == vmact->xres) &&
-				(fbi->var.yres == vmact->yres) &&
-				(fbi->var.left_margin == vmact->left_margin) &&
-				(fbi->var.right_margin == vmact->right_margin) &&
-				(fbi->var.upper_margin == vmact->upper_margin) &&
-				(fbi->var.lower_margin == vmact->lower_margin) &&
-				(fbi->var.hsync_len == vmact->hsync_len) &&
-				(fbi->var.vsync_len == vmact->vsync_len) &&
-				(fbi->var.pixclock == vmact->pixclock))
-			{
-				resolution_change = false;  
+			    (fbi->var.yres == vmact->yres) &&
+			    (fbi->var.left_margin == vmact->left_margin) &&
+			    (fbi->var.right_margin == vmact->right_margin) &&
+			    (fbi->var.upper_margin == vmact->upper_margin) &&
+			    (fbi->var.lower_margin == vmact->lower_margin) &&
+			    (fbi->var.hsync_len == vmact->hsync_len) &&
+			    (fbi->var.vsync_len == vmact->vsync_len) &&
+			    (fbi->var.pixclock == vmact->pixclock) &&
+			    (fbi->var.sync == vmact->sync) &&
+			    ((fbi->var.vmode & FB_VMODE_MASK) ==
+			     (vmact->vmode & FB_VMODE_MASK)))
+				vmode_change = false;
+		} else {
+			if ((fbi->var.xres == vmact->xres) &&
+			    (fbi->var.yres == vmact->yres) &&
+			    (!refresh ||
+			     (abs((int)refresh - (int)vmact->refresh) <=
+			      XYLONFB_MODE_REFRESH_TOLERANCE)))
+				vmode_change = false;
+		}
+	}
+
+	if ((data->flags & XYLONFB_FLAGS_VMODE_INIT) &&
+	    (data->flags & XYLONFB_FLAGS_SEAMLESS_HANDOFF)) {
+		if (xylonfb_handoff_timings(data)) {
+			dev_info(dev, "seamless handoff %s\n",
+				 data->vm_active.name);
+			xylonfb_handoff_rate(data);
+			xylonfb_fbi_update(fbi);
+			data->flags |= XYLONFB_FLAGS_VMODE_SET;
+			return 0;
+		}
+		dev_info(dev, "seamless handoff mode mismatch\n");
+		data->flags &= ~XYLONFB_FLAGS_SEAMLESS_HANDOFF;
+	}
+
+	if (!vmode_change && !(data->flags & XYLONFB_FLAGS_VMODE_INIT))
+		return 0;
+
+	vm_old = data->vm_active;
+	diff = XYLONFB_VMODE_DIFF_PIXCLK | XYLONFB_VMODE_DIFF_PORCHES |
+	       XYLONFB_VMODE_DIFF_TIMINGS;
+
+	if (!(data->flags & XYLONFB_FLAGS_VMODE_INIT)) {
+		mode = NULL;
+		mode_flags = 0;
+		if (!(data->flags & XYLONFB_FLAGS_PUT_VSCREENINFO_EXACT)) {
+			if ((data->flags & XYLONFB_FLAGS_EDID_VMODE) &&
+			    (data->flags & XYLONFB_FLAGS_EDID_READY)) {
+				if (data->mode_db.edid != fbi->monspecs.modedb)
+					xylonfb_mode_update(data,
+							    &fbi->monspecs);
+			} else {
+				if (data->mode_db.edid)
+					xylonfb_mode_update(data,
+							    &fbi->monspecs);
+				mode_flags =
+					xylonfb_mode_flags(&data->vm_active);
 			}
+			mode = xylonfb_mode_find(data, fbi->var.xres,
+						 fbi->var.yres, refresh,
+						 mode_flags);
 		}
-		else {
-			if ((fbi->var.xres == vmact->xres) &&
-				(fbi->var.yres == vmact->yres))
-				resolution_change = false;  
+
+		if (mode) {
+			xylonfb_set_vmode_active(data, mode,
+						 fbi->var.bits_per_pixel);
+		} else {
+			data->vm_active.vmode.refresh = refresh ? refresh : 60;
+			snprintf(data->vmode_opt, sizeof(data->vmode_opt),
+				 "%dx%d%s-%d@%d%s",
+				 fbi->var.xres, fbi->var.yres,
+				 data->vm_active.opts_cvt,
+				 fbi->var.bits_per_pixel,
+				 data->vm_active.vmode.refresh,
+				 data->vm_active.opts_ext);
+			/* exact timings may differ from default mode ones */
+			if (!strcmp(data->vm.name, data->vmode_opt) &&
+			    !(data->flags &
+			      XYLONFB_FLAGS_PUT_VSCREENINFO_EXACT)) {
+				data->vm_active = data->vm;
+			} else {
+				bpp = fbi->var.bits_per_pixel;
+				data->vmode_option = data->vmode_opt;
+				ret = xylonfb_set_timings(fbi, bpp);
+				data->vmode_option = NULL;
+			}
+			if (ret) {
+				data->vm_active = vm_old;
+				return ret;
+			}
+			if (!(data->flags & XYLONFB_FLAGS_PUT_VSCREENINFO_EXACT))
+				xylonfb_mode_add(data, &data->vm_active.vmode,
+						 mode_flags);
 		}
 	}
 
-	if (resolution_change || (data->flags & XYLONFB_FLAGS_VMODE_INIT)) {
+	xylonfb_vmode_fit(fbi);
+	xylonfb_set_fbi_var_screeninfo(&fbi->var, data);
+	if (!(data->flags & XYLONFB_FLAGS_VMODE_INIT))
+		diff = xylonfb_vmode_diff(&vm_old, &data->vm_active);
+
+	XYLONFB_DBG(INFO, "video mode: %dx%d%s-%d@%d%s, diff 0x%x\n",
+		    fbi->var.xres, fbi->var.yres,
+		    data->vm_active.opts_cvt,
+		    fbi->var.bits_per_pixel,
+		    data->vm_active.vmode.refresh,
+		    data->vm_active.opts_ext, diff);
+
+	/* Only resolution and polarity changes require output off */
+	if (diff & XYLONFB_VMODE_DIFF_TIMINGS) {
 		if (!(data->flags & XYLONFB_FLAGS_VMODE_INIT)) {
 			struct xylonfb_layer_data *ld;
 
@@ -344,248 +787,236 @@ static int xylonfb_set_par(struct fb_info *fbi)
 		xylonfb_disable_logicvc_output(fbi);
 		xylonfb_logicvc_disp_ctrl(fbi, false);
 
-		if (!(data->flags & XYLONFB_FLAGS_VMODE_INIT)) {
-			data->vm_active.vmode.refresh = 60;
-			sprintf(vmode_opt, "%dx%d%s-%d@%d%s",
-				fbi->var.xres, fbi->var.yres,
-				data->vm_active.opts_cvt,
-				fbi->var.bits_per_pixel,
-				data->vm_active.vmode.refresh,
-				data->vm_active.opts_ext);
-			if (!strcmp(data->vm.name, vmode_opt)) {
-				data->vm_active = data->vm;
-			} else {
-				bpp = fbi->var.bits_per_pixel;
-				xylonfb_mode_option = vmode_opt;
-				ret = xylonfb_set_timings(fbi, bpp);
-				xylonfb_mode_option = NULL;
-			}
-		}
-		if (!ret) {
-			f = PICOS2KHZ(data->vm_active.vmode.pixclock);
+		if (diff & XYLONFB_VMODE_DIFF_PIXCLK) {
+			f = data->vm_active.pixclk_khz;
 			if (data->flags & XYLONFB_FLAGS_PIXCLK_VALID)
-				if (xylonfb_hw_pixclk_set(&data->pdev->dev,
-							  data->pixel_clock, f))
+				if (xylonfb_hw_pixclk_set(data, f))
 					dev_err(dev,
 						"failed set pixel clock\n");
-
-			xylonfb_fbi_update(fbi);
-			XYLONFB_DBG(INFO, "video mode: %dx%d%s-%d@%d%s\n",
-				    fbi->var.xres, fbi->var.yres,
-				    data->vm_active.opts_cvt,
-				    fbi->var.bits_per_pixel,
-				    data->vm_active.vmode.refresh,
-				    data->vm_active.opts_ext);
 		}
+	} else if (diff) {
+		ret = xylonfb_set_porches_seamless(fbi, diff);
+		if (ret) {
+			data->vm_active = vm_old;
+			xylonfb_set_fbi_var_screeninfo(&fbi->var, data);
+			return ret;
+		}
+	}
 
-		xylonfb_enable_logicvc_output(fbi);
-		xylonfb_logicvc_disp_ctrl(fbi, true);
+	xylonfb_fbi_update(fbi);
 
-		if (data->flags & XYLONFB_FLAGS_VMODE_INIT)
-			data->flags |= XYLONFB_FLAGS_VMODE_SET;
+	if (!(diff & XYLONFB_VMODE_DIFF_TIMINGS))
+		return 0;
 
-		if (!(data->flags & XYLONFB_FLAGS_VMODE_SET)) {
-			if (!afbi) {
-				xylonfb_logicvc_layer_enable(fbi, true);
-				return ret;
-			}
+	xylonfb_enable_logicvc_output(fbi);
+	xylonfb_logicvc_disp_ctrl(fbi, true);
 
-			for (i = 0; i < data->layers; i++) {
-				if (layer_on[i])
-					xylonfb_logicvc_layer_enable(afbi[i],
-								     true);
-			}
+	/*
+	 * Interlaced video mode pans are applied from V sync interrupt,
+	 * which is enabled by xylonfb_start() at driver load.
+	 */
+	interlaced = data->vm_active.vmode.vmode & FB_VMODE_INTERLACED;
+	if (!(data->flags & XYLONFB_FLAGS_VMODE_INIT) &&
+	    (interlaced != (vm_old.vmode.vmode & FB_VMODE_INTERLACED))) {
+		if (!interlaced)
+			xylonfb_flip_apply(data);
+		xylonfb_vsync_ctrl(fbi, interlaced ||
+				   (data->flags & XYLONFB_FLAGS_VSYNC_IRQ));
+	}
+
+	if (data->flags & XYLONFB_FLAGS_VMODE_INIT)
+		data->flags |= XYLONFB_FLAGS_VMODE_SET;
+
+	if (!(data->flags & XYLONFB_FLAGS_VMODE_SET)) {
+		if (!afbi) {
+			xylonfb_logicvc_layer_enable(fbi, true);
+			return 0;
+		}
+
+		for (i = 0; i < data->layers; i++) {
+			if (layer_on[i])
+				xylonfb_logicvc_layer_enable(afbi[i], true);
 		}
 	}
 
+	return 0;
+}
+
+/*
+ * Mode set of one device is serialized, as its layers have separate
+ * fb_info locks. Devices do not share mode state.
+ */
+static int xylonfb_set_par(struct fb_info *fbi)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	struct xylonfb_data *data = ld->data;
+	int ret;
+
+	mutex_lock(&data->vmode_mutex);
+	ret = xylonfb_set_vmode(fbi);
+	mutex_unlock(&data->vmode_mutex);
+
 	return ret;
 }
 
-static void xylonfb_set_color_hw_rgb2yuv(u16 t, u16 r, u16 g, u16 b, u32 *yuv,
-					 struct xylonfb_layer_data *ld)
+/* Writes palette entries differing from CLUT bank contents */
+static u32 xylonfb_clut_write(struct xylonfb_layer_data *ld, u32 bank)
+{
+	struct xylonfb_clut *clut = &ld->clut;
+	void __iomem *clut_base = ld->clut_base + (bank * LOGICVC_CLUT_OFFSET);
+	u32 i, writes = 0;
+
+	for (i = 0; i < LOGICVC_CLUT_SIZE; i++) {
+		if (clut->hw_valid[bank] && (clut->hw[bank][i] == clut->val[i]))
+			continue;
+		writel(clut->val[i],
+		       clut_base + (i * LOGICVC_CLUT_REGISTER_SIZE));
+		clut->hw[bank][i] = clut->val[i];
+		writes++;
+	}
+	clut->hw_valid[bank] = true;
+
+	return writes;
+}
+
+/*
+ * CLUT bank switch is signaled by CLUT_SW interrupt of the layer, which
+ * comes only with frames scanned out.
+ */
+static bool xylonfb_clut_switch_irq(struct xylonfb_layer_data *ld)
+{
+	struct xylonfb_data *data = ld->data;
+	u32 mask;
+
+	/* interrupts are enabled by xylonfb_start() at the end of probe */
+	if (!dev_get_drvdata(&data->pdev->dev) ||
+	    (data->pwr_state < XYLONFB_POWER_SIGNAL))
+		return false;
+
+	mask = data->reg_access.get_reg_val(data->dev_base,
+					    LOGICVC_INT_MASK_ROFF, ld);
+
+	return !(mask & (LOGICVC_INT_L0_CLUT_SW << ld->fd->id));
+}
+
+static bool xylonfb_clut_switching(struct xylonfb_layer_data *ld)
+{
+	struct xylonfb_data *data = ld->data;
+	unsigned long flags;
+	bool switching;
+
+	spin_lock_irqsave(&data->clut_lock, flags);
+	switching = ld->clut.switching;
+	spin_unlock_irqrestore(&data->clut_lock, flags);
+
+	return switching;
+}
+
+/*
+ * Palette is written to the inactive CLUT bank and logiCVC is requested
+ * to switch to it at the next frame.
+ * Switch completion is signaled by CLUT_SW interrupt. Without it, or if
+ * previous switch is not signaled in time, palette is written to both
+ * banks and bank selected in logiCVC is taken as the active one.
+ */
+static void xylonfb_clut_update(struct xylonfb_layer_data *ld)
 {
 	struct xylonfb_data *data = ld->data;
-	u32 y, u, v;
+	struct xylonfb_clut *clut = &ld->clut;
+	unsigned long flags;
+	u32 bank, sel;
+	bool direct;
 
 	XYLONFB_DBG(INFO, "%s", __func__);
 
-	y = ((data->coeff.cyr * (r & 0xFF)) + (data->coeff.cyg * (g & 0xFF)) +
-	     (data->coeff.cyb * (b & 0xFF)) + data->coeff.cy) /
-	     LOGICVC_YUV_NORM;
-	u = ((-data->coeff.cur * (r & 0xFF)) - (data->coeff.cug * (g & 0xFF)) +
-	     (data->coeff.cub * (b & 0xFF)) + LOGICVC_COEFF_U) /
-	     LOGICVC_YUV_NORM;
-	v = ((data->coeff.cvr * (r & 0xFF)) - (data->coeff.cvg * (g & 0xFF)) -
-	     (data->coeff.cvb * (b & 0xFF)) + LOGICVC_COEFF_V) /
-	     LOGICVC_YUV_NORM;
-
-	*yuv = ((t & 0xFF) << 24) | (y << 16) | (u << 8) | v;
+	/* panic: no waiting and no locking */
+	if (oops_in_progress) {
+		xylonfb_clut_write(ld, 0);
+		xylonfb_clut_write(ld, 1);
+		return;
+	}
+
+	direct = in_interrupt() || !xylonfb_clut_switch_irq(ld);
+	if (!direct &&
+	    !wait_event_timeout(data->clut_wait, !xylonfb_clut_switching(ld),
+				HZ/10))
+		direct = true;
+
+	spin_lock_irqsave(&data->clut_lock, flags);
+
+	sel = data->reg_access.get_reg_val(data->dev_base,
+					   LOGICVC_CLUT_SELECT_ROFF, ld);
+
+	if (direct) {
+		clut->switching = false;
+		clut->bank = (sel >> ld->fd->id) & 1;
+		xylonfb_clut_write(ld, 0);
+		xylonfb_clut_write(ld, 1);
+		goto unlock;
+	}
+
+	/* active bank already holds the palette */
+	if (clut->hw_valid[clut->bank] &&
+	    !memcmp(clut->hw[clut->bank], clut->val, sizeof(clut->val)))
+		goto unlock;
+
+	bank = clut->bank ^ 1;
+
+	xylonfb_clut_write(ld, bank);
+
+	if (bank)
+		sel |= (1 << ld->fd->id);
+	else
+		sel &= ~(1 << ld->fd->id);
+
+	clut->switching = true;
+	data->reg_access.set_reg_val(sel, data->dev_base,
+				     LOGICVC_CLUT_SELECT_ROFF, ld);
+
+unlock:
+	spin_unlock_irqrestore(&data->clut_lock, flags);
 }
 
 static int xylonfb_set_color_hw(u16 *t, u16 *r, u16 *g, u16 *b,
 				int len, int id, struct fb_info *fbi)
 {
 	struct xylonfb_layer_data *ld = fbi->par;
-	struct xylonfb_layer_fix_data *fd = ld->fd;
-	u32 pixel, pixel_clut;
+	const struct xylonfb_format *fmt = xylonfb_get_color_format(ld->fd);
+	u32 *palette;
 	u16 a = 0xFF;
-	int bpp, to, ro, go, bo;
+	int i;
 
 	XYLONFB_DBG(INFO, "%s", __func__);
 
-	bpp = fd->bpp;
-
-	to = fbi->var.transp.offset;
-	ro = fbi->var.red.offset;
-	go = fbi->var.green.offset;
-	bo = fbi->var.blue.offset;
+	if (!fmt->pack)
+		return -EINVAL;
 
 	switch (fbi->fix.visual) {
 	case FB_VISUAL_PSEUDOCOLOR:
-		if ((id > (LOGICVC_CLUT_SIZE - 1)) || (len > LOGICVC_CLUT_SIZE))
+		if ((id < 0) || (len < 0) ||
+		    ((id + len) > LOGICVC_CLUT_SIZE))
 			return -EINVAL;
-
-		switch (fd->format_clut) {
-		case XYLONFB_FORMAT_CLUT_ARGB6565:
-			while (len > 0) {
-				if (t)
-					a = t[id];
-				pixel_clut = ((((a & 0xFC) >> 2) << to) |
-					      (((r[id] & 0xF8) >> 3) << ro) |
-					      (((g[id] & 0xFC) >> 2) << go) |
-					      (((b[id] & 0xF8) >> 3) << bo));
-				writel(pixel_clut, ld->clut_base +
-				       (id*LOGICVC_CLUT_REGISTER_SIZE));
-				len--;
-				id++;
-			}
-			break;
-		case XYLONFB_FORMAT_CLUT_ARGB8888:
-			while (len > 0) {
-				if (t)
-					a = t[id];
-				pixel_clut = (((a & 0xFF) << to) |
-					      ((r[id] & 0xFF) << ro) |
-					      ((g[id] & 0xFF) << go) |
-					      ((b[id] & 0xFF) << bo));
-				writel(pixel_clut, ld->clut_base +
-				       (id*LOGICVC_CLUT_REGISTER_SIZE));
-				len--;
-				id++;
-			}
-			break;
-		case XYLONFB_FORMAT_CLUT_AYUV8888:
-			while (len > 0) {
-				if (t)
-					a = t[id];
-				xylonfb_set_color_hw_rgb2yuv(a, r[id],
-							     g[id], b[id],
-					 		     &pixel_clut,
-					 		     ld);
-				writel(pixel_clut, ld->clut_base +
-				       (id*LOGICVC_CLUT_REGISTER_SIZE));
-				len--;
-				id++;
-			}
-			break;
-		}
+		palette = ld->clut.val;
 		break;
 	case FB_VISUAL_TRUECOLOR:
-		switch (fd->format) {
-		case XYLONFB_FORMAT_RGB332:
-		case XYLONFB_FORMAT_BGR233:
-			while (len > 0) {
-				pixel = ((((r[id] & 0xE0) >> 5) << ro) |
-					(((g[id] & 0xE0) >> 5) << go) |
-					(((b[id] & 0xC0) >> 6) << bo));
-				((u32 *)(fbi->pseudo_palette))[id] =
-					(pixel << 24) | (pixel << 16) |
-					(pixel << 8) | pixel;
-				len--;
-				id++;
-			}
-			break;
-		case XYLONFB_FORMAT_RGB565:
-		case XYLONFB_FORMAT_BGR565:
-			while (len > 0) {
-				pixel = ((((r[id] & 0xF8) >> 3) << ro) |
-					(((g[id] & 0xFC) >> 2) << go) |
-					(((b[id] & 0xF8) >> 3) << bo));
-				((u32 *)(fbi->pseudo_palette))[id] =
-					(pixel << 16) | pixel;
-				len--;
-				id++;
-			}
-			break;
-		case XYLONFB_FORMAT_XRGB8888:
-		case XYLONFB_FORMAT_XBGR8888:
-			while (len > 0) {
-				((u32 *)(fbi->pseudo_palette))[id] =
-					(((r[id] & 0xFF) << ro) |
-					((g[id] & 0xFF) << go) |
-					((b[id] & 0xFF) << bo));
-				len--;
-				id++;
-			}
-			break;
-		case XYLONFB_FORMAT_ARGB8888:
-		case XYLONFB_FORMAT_ABGR8888:
-			while (len > 0) {
-				if (t)
-					a = t[id];
-				((u32 *)(fbi->pseudo_palette))[id] =
-					(((a & 0xFF) << to) |
-					((r[id] & 0xFF) << ro) |
-					((g[id] & 0xFF) << go) |
-					((b[id] & 0xFF) << bo));
-				len--;
-				id++;
-			}
-			break;
-		case XYLONFB_FORMAT_ARGB3332:
-		case XYLONFB_FORMAT_ABGR3233:
-			while (len > 0) {
-				if (t)
-					a = t[id];
-				pixel = ((((a & 0xE0) >> 5) << to) |
-				(((r[id] & 0xE0) >> 5) << ro) |
-				(((g[id] & 0xE0) >> 5) << go) |
-				(((b[id] & 0xC0) >> 6) << bo));
-				((u32 *)(fbi->pseudo_palette))[id] =
-					(pixel << 16) | pixel;
-				len--;
-				id++;
-			} break;
-		case XYLONFB_FORMAT_ARGB565:
-		case XYLONFB_FORMAT_ABGR565:
-			while (len > 0) {
-				if (t)
-					a = t[id];
-				((u32 *)(fbi->pseudo_palette))[id] =
-					((((a & 0xFC) >> 2) << to) |
-					(((r[id] & 0xF8) >> 3) << ro) |
-					(((g[id] & 0xFC) >> 2) << go) |
-					(((b[id] & 0xF8) >> 3) << bo));
-				len--;
-				id++;
-			} break;
-		case XYLONFB_FORMAT_XRGB2101010:
-		case XYLONFB_FORMAT_XBGR2101010:
-			while (len > 0) {
-				((u32 *)(fbi->pseudo_palette))[id] =
-					(((r[id] & 0x3FF) << ro) |
-					((g[id] & 0x3FF) << go) |
-					((b[id] & 0x3FF) << bo));
-				len--;
-				id++;
-			}
-			break;
-		}
+		if ((id < 0) || (len < 0) ||
+		    ((id + len) > XYLONFB_PSEUDO_PALETTE_SIZE))
+			return -EINVAL;
+		palette = fbi->pseudo_palette;
 		break;
 	default:
 		return -EINVAL;
 	}
 
+	for (i = 0; i < len; i++) {
+		if (t)
+			a = t[i];
+		palette[id + i] = fmt->pack(fbi, a, r[i], g[i], b[i]);
+	}
+
+	if (fbi->fix.visual == FB_VISUAL_PSEUDOCOLOR)
+		xylonfb_clut_update(ld);
+
 	return 0;
 }
 
@@ -609,60 +1040,14 @@ static int xylonfb_set_cmap(struct fb_cmap *cmap, struct fb_info *fbi)
 				    cmap->len, cmap->start, fbi);
 }
 
-static void xylonfb_set_pixels(struct fb_info *fbi,
-			       struct xylonfb_layer_data *ld,
-			       int bpp, unsigned int pix)
-{
-	u32 *vmem;
-	u8 *vmem8;
-	u16 *vmem16;
-	u32 *vmem32;
-	int x, y, pixoffset;
-
-	XYLONFB_DBG(INFO, "%s", __func__);
-
-	vmem = ld->fb_base + (fbi->var.xoffset * (fbi->var.bits_per_pixel/4)) +
-	       (fbi->var.yoffset * fbi->var.xres_virtual *
-	       (fbi->var.bits_per_pixel/4));
-
-	switch (bpp) {
-	case 8:
-		vmem8 = (u8 *)vmem;
-		for (y = fbi->var.yoffset; y < fbi->var.yres; y++) {
-			pixoffset = (y * fbi->var.xres_virtual);
-			for (x = fbi->var.xoffset; x < fbi->var.xres; x++)
-				vmem8[pixoffset + x] = pix;
-		}
-		break;
-	case 16:
-		vmem16 = (u16 *)vmem;
-		for (y = fbi->var.yoffset; y < fbi->var.yres; y++) {
-			pixoffset = (y * fbi->var.xres_virtual);
-			for (x = fbi->var.xoffset; x < fbi->var.xres; x++)
-				vmem16[pixoffset + x] = pix;
-		}
-		break;
-	case 32:
-		vmem32 = (u32 *)vmem;
-		for (y = fbi->var.yoffset; y < fbi->var.yres; y++) {
-			pixoffset = (y * fbi->var.xres_virtual);
-			for (x = fbi->var.xoffset; x < fbi->var.xres; x++)
-				vmem32[pixoffset + x] = pix;
-		}
-		break;
-	}
-}
-
 static int xylonfb_blank(int blank_mode, struct fb_info *fbi)
 {
 	struct xylonfb_layer_data *ld = fbi->par;
 	struct xylonfb_data *data = ld->data;
-	struct xylonfb_layer_fix_data *fd = ld->fd;
 	void __iomem *dev_base = data->dev_base;
 	u32 ctrl = data->reg_access.get_reg_val(dev_base,
 						LOGICVC_CTRL_ROFF,
 						ld);
-	u32 power = readl(dev_base + LOGICVC_POWER_CTRL_ROFF);
 
 	XYLONFB_DBG(INFO, "%s", __func__);
 
@@ -674,46 +1059,14 @@ static int xylonfb_blank(int blank_mode, struct fb_info *fbi)
 		data->reg_access.set_reg_val(ctrl, dev_base,
 					     LOGICVC_CTRL_ROFF, ld);
 
-		power |= LOGICVC_V_EN_MSK;
-		writel(power, dev_base + LOGICVC_POWER_CTRL_ROFF);
+		xylonfb_pwr_request(data, XYLONFB_POWER_ON);
 
-		mdelay(50);
+		xylonfb_logicvc_layer_blank(fbi, false);
 		break;
 
 	case FB_BLANK_NORMAL:
 		XYLONFB_DBG(INFO, "FB_BLANK_NORMAL");
-		switch (fd->format) {
-		case XYLONFB_FORMAT_C8:
-			xylonfb_set_color(0, 0, 0, 0, 0xFF, fbi);
-			xylonfb_set_pixels(fbi, ld, 8, 0);
-			break;
-		case XYLONFB_FORMAT_RGB332:
-		case XYLONFB_FORMAT_BGR233:
-			xylonfb_set_pixels(fbi, ld, 8, 0x00);
-			break;
-		case XYLONFB_FORMAT_ARGB3332:
-		case XYLONFB_FORMAT_ABGR3233:
-			xylonfb_set_pixels(fbi, ld, 16, 0xFF00);
-			break;
-		case XYLONFB_FORMAT_RGB565:
-		case XYLONFB_FORMAT_ARGB565:
-			xylonfb_set_pixels(fbi, ld, 16, 0x0000);
-			break;
-		case XYLONFB_FORMAT_ABGR565:
-		case XYLONFB_FORMAT_BGR565:
-			xylonfb_set_pixels(fbi, ld, 32, 0xFFFF0000);
-			break;
-		case XYLONFB_FORMAT_XRGB8888:
-		case XYLONFB_FORMAT_ARGB8888:
-		case XYLONFB_FORMAT_XBGR8888:
-		case XYLONFB_FORMAT_ABGR8888:
-			xylonfb_set_pixels(fbi, ld, 32, 0xFF000000);
-			break;
-		case XYLONFB_FORMAT_XRGB2101010:
-		case XYLONFB_FORMAT_XBGR2101010:
-			xylonfb_set_pixels(fbi, ld, 32, 0xC0000000);
-			break;
-		}
+		xylonfb_logicvc_layer_blank(fbi, true);
 		break;
 
 	case FB_BLANK_POWERDOWN:
@@ -723,10 +1076,7 @@ static int xylonfb_blank(int blank_mode, struct fb_info *fbi)
 		data->reg_access.set_reg_val(ctrl, dev_base,
 					     LOGICVC_CTRL_ROFF, ld);
 
-		power &= ~LOGICVC_V_EN_MSK;
-		writel(power, dev_base + LOGICVC_POWER_CTRL_ROFF);
-
-		mdelay(50);
+		xylonfb_pwr_request(data, XYLONFB_POWER_VDD);
 		break;
 
 	case FB_BLANK_VSYNC_SUSPEND:
@@ -753,17 +1103,25 @@ static int xylonfb_pan_display(struct fb_var_screeninfo *var,
 	struct xylonfb_layer_data *ld = fbi->par;
 	struct xylonfb_data *data = ld->data;
 	struct xylonfb_layer_fix_data *fd = ld->fd;
+	unsigned long flags;
 
 	XYLONFB_DBG(INFO, "%s", __func__);
 
-	if (!(data->flags & XYLONFB_FLAGS_SIZE_POSITION))
+	if (!(data->flags & (XYLONFB_FLAGS_SIZE_POSITION |
+			     XYLONFB_FLAGS_DYNAMIC_LAYER_ADDRESS)))
 		return -EINVAL;
 
 	if ((fbi->var.xoffset == var->xoffset) &&
 	    (fbi->var.yoffset == var->yoffset))
 		return 0;
 
-	if (fbi->var.vmode & FB_VMODE_YWRAP) {
+	/*
+	 * Layer is scanned out linearly from its start address, and can not
+	 * wrap around the end of video memory. Console scrolling reaches the
+	 * end of virtual area by panning, and then moves the screen back to
+	 * the top with copy or redraw.
+	 */
+	if (var->vmode & FB_VMODE_YWRAP) {
 		return -EINVAL;
 	} else {
 		if (((var->xoffset + fbi->var.xres) > fbi->var.xres_virtual) ||
@@ -771,29 +1129,21 @@ static int xylonfb_pan_display(struct fb_var_screeninfo *var,
 			return -EINVAL;
 	}
 
-	if (fd->format == XYLONFB_FORMAT_YUYV ||
-		fd->format == XYLONFB_FORMAT_UYVY ||
-		fd->format == XYLONFB_FORMAT_YUYV_121010 ||
-		fd->format == XYLONFB_FORMAT_UYVY_121010)
+	if (xylonfb_get_format(fd->format)->yuv422)
 		var->xoffset &= ~((unsigned long) + 1);
 
 	fbi->var.xoffset = var->xoffset;
 	fbi->var.yoffset = var->yoffset;
 
-	if (!(data->flags & XYLONFB_FLAGS_DYNAMIC_LAYER_ADDRESS)) {
-		data->reg_access.set_reg_val(var->xoffset, ld->base,
-					     LOGICVC_LAYER_HOFF_ROFF, ld);
-		data->reg_access.set_reg_val(var->yoffset, ld->base,
-					     LOGICVC_LAYER_VOFF_ROFF, ld);
-	}
-
-	if (data->flags & XYLONFB_FLAGS_DYNAMIC_LAYER_ADDRESS) {
-		ld->fb_pbase_active = ld->fb_pbase +
-				      ((var->xoffset * (fd->bpp / 8)) +
-				      (var->yoffset * fd->width *
-				      (fd->bpp / 8)));
-		data->reg_access.set_reg_val(ld->fb_pbase_active, ld->base,
-					     LOGICVC_LAYER_ADDR_ROFF, ld);
+	/* interlaced frame is flipped at its start, from V sync interrupt */
+	if (data->vm_active.vmode.vmode & FB_VMODE_INTERLACED) {
+		spin_lock_irqsave(&data->flip_lock, flags);
+		ld->flip_xoffset = var->xoffset;
+		ld->flip_yoffset = var->yoffset;
+		ld->flip_pending = true;
+		spin_unlock_irqrestore(&data->flip_lock, flags);
+	} else {
+		xylonfb_pan_regs(fbi, var->xoffset, var->yoffset);
 	}
 
 	return 0;
@@ -809,9 +1159,10 @@ static struct fb_ops xylonfb_ops = {
 	.fb_setcmap = xylonfb_set_cmap,
 	.fb_blank = xylonfb_blank,
 	.fb_pan_display = xylonfb_pan_display,
-	.fb_fillrect = cfb_fillrect,
-	.fb_copyarea = cfb_copyarea,
-	.fb_imageblit = cfb_imageblit,
+	.fb_fillrect = xylonfb_fillrect,
+	.fb_copyarea = xylonfb_copyarea,
+	.fb_imageblit = xylonfb_imageblit,
+	.fb_sync = xylonfb_sync,
 	.fb_ioctl = xylonfb_ioctl,
 };
 
@@ -827,6 +1178,8 @@ static int xylonfb_find_next_layer(struct xylonfb_data *data, int layers,
 	XYLONFB_DBG(INFO, "%s", __func__);
 
 	for (i = 0; i < layers; i++) {
+		if (i == id || !data->fd[i]->address)
+			continue;
 		loop_address = data->fd[i]->address;
 		if ((address < loop_address) && (loop_address < temp_address)) {
 			next = i;
@@ -837,43 +1190,165 @@ static int xylonfb_find_next_layer(struct xylonfb_data *data, int layers,
 	return next;
 }
 
-static void xylonfb_get_vmem_height(struct xylonfb_data *data, int layers,
-				    int id)
+static int xylonfb_vmem_plan_layer(struct xylonfb_data *data, int id)
 {
+	struct device *dev = &data->pdev->dev;
 	struct xylonfb_layer_fix_data *fd = data->fd[id];
-	dma_addr_t vmem_start = fd->address;
-	dma_addr_t vmem_end;
-	int next;
+	u32 burst = data->burst_size;
+	u32 line_length = fd->width * (fd->bpp / 8);
+	u32 buffer_length;
+	dma_addr_t vmem_end = 0;
+	int next, i;
 
 	XYLONFB_DBG(INFO, "%s", __func__);
 
-	if (fd->address_range && (id < (layers - 1))) {
-		fd->height = fd->address_range / (fd->width * (fd->bpp / 8));
-		return;
-	}
+	fd->line_padding = ALIGN(line_length, burst) - line_length;
+	if (fd->line_padding)
+		dev_warn(dev, "layer %d line %d not aligned to %d bytes burst\n",
+			 id, line_length, burst);
 
-	vmem_start = fd->address;
+	if (fd->address) {
+		if (fd->address & (burst - 1))
+			dev_warn(dev,
+				 "layer %d address 0x%08x not burst aligned\n",
+				 id, fd->address);
+
+		/* shared layer memory is allowed, layers share the height */
+		for (i = 0; i < id; i++)
+			if (data->fd[i]->address == fd->address)
+				dev_warn(dev,
+					 "layer %d memory shared with layer %d\n",
+					 id, i);
+
+		if (fd->address_range)
+			vmem_end = fd->address + fd->address_range;
+
+		next = xylonfb_find_next_layer(data, data->layers, id);
+		if (next != -1) {
+			if (!vmem_end)
+				vmem_end = data->fd[next]->address;
+			if (vmem_end > data->fd[next]->address) {
+				dev_err(dev, "layer %d memory overlaps layer %d\n",
+					id, next);
+				vmem_end = data->fd[next]->address;
+			}
+		}
 
-	next = xylonfb_find_next_layer(data, layers, id);
-	if (next == -1) {
-		if (fd->address_range) {
-			fd->height = fd->address_range /
-				     (fd->width * (fd->bpp / 8));
+		if (vmem_end) {
+			fd->height = (vmem_end - fd->address) / line_length;
 		} else {
 			if (fd->buffer_offset)
-				fd->height = fd->buffer_offset *
-					     LOGICVC_MAX_LAYER_BUFFERS;
+				fd->height = fd->buffer_offset * fd->buffers;
 			else
 				fd->height = XYLONFB_VRES_DEFAULT;
 		}
+		if (fd->height == 0) {
+			dev_err(dev, "layer %d memory too small\n", id);
+			return -EINVAL;
+		}
 	} else {
-		vmem_end = data->fd[next]->address;
-		fd->height = (vmem_end - vmem_start) /
-			     (fd->width * (fd->bpp / 8));
+		if (fd->buffer_offset)
+			fd->height = fd->buffer_offset * fd->buffers;
+		else
+			fd->height = XYLONFB_VRES_DEFAULT * fd->buffers;
 	}
 
-	if (fd->height > (data->max_v_res * LOGICVC_MAX_LAYER_BUFFERS))
-		fd->height = data->max_v_res * LOGICVC_MAX_LAYER_BUFFERS;
+	if (fd->height > (data->max_v_res * XYLONFB_MAX_LAYER_BUFFERS))
+		fd->height = data->max_v_res * XYLONFB_MAX_LAYER_BUFFERS;
+
+	fd->buffer_padding = 0;
+	if (fd->buffer_offset) {
+		buffer_length = fd->buffer_offset * line_length;
+		fd->buffer_padding = ALIGN(buffer_length, burst) -
+				     buffer_length;
+		if (fd->buffer_padding)
+			dev_warn(dev,
+				 "layer %d buffer offset not burst aligned\n",
+				 id);
+	}
+
+	XYLONFB_DBG(INFO, "Layer %d memory plan\n" \
+		    "    Line %d bytes, %d bytes burst padding\n" \
+		    "    Height %d lines\n", \
+		    id, line_length, fd->line_padding, fd->height);
+
+	return 0;
+}
+
+/*
+ * Computes memory layout of all layers and their buffers, checks
+ * layer memory alignment to the logiCVC memory burst size and overlapping
+ * of layer memory regions.
+ */
+static int xylonfb_vmem_plan(struct xylonfb_data *data)
+{
+	int i, ret;
+
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	for (i = 0; i < data->layers; i++) {
+		ret = xylonfb_vmem_plan_layer(data, i);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+u32 xylonfb_get_buffer_lines(struct xylonfb_layer_fix_data *fd, u32 yres)
+{
+	/* HW buffer switching uses fixed buffer offset */
+	if (fd->buffer_offset)
+		return fd->buffer_offset;
+
+	return yres;
+}
+
+static u32 xylonfb_get_buffers_height(struct xylonfb_layer_data *ld, u32 yres)
+{
+	struct xylonfb_layer_fix_data *fd = ld->fd;
+	u32 height = xylonfb_get_buffer_lines(fd, yres) * ld->buffers;
+
+	if (height > fd->height)
+		height = fd->height;
+
+	return height;
+}
+
+u32 xylonfb_get_max_buffers(struct fb_info *fbi)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	struct xylonfb_layer_fix_data *fd = ld->fd;
+	u32 buffers;
+
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	buffers = fd->height / xylonfb_get_buffer_lines(fd, fbi->var.yres);
+	if (buffers > XYLONFB_MAX_LAYER_BUFFERS)
+		buffers = XYLONFB_MAX_LAYER_BUFFERS;
+	else if (buffers == 0)
+		buffers = 1;
+
+	return buffers;
+}
+
+void xylonfb_set_buffers(struct fb_info *fbi, u32 buffers)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	struct fb_var_screeninfo var;
+
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	ld->buffers = buffers;
+
+	fbi->var.yres_virtual = xylonfb_get_buffers_height(ld, fbi->var.yres);
+	fbi->fix.smem_len = fbi->fix.line_length * fbi->var.yres_virtual;
+
+	if ((fbi->var.yoffset + fbi->var.yres) > fbi->var.yres_virtual) {
+		var = fbi->var;
+		var.yoffset = 0;
+		xylonfb_pan_display(&var, fbi);
+	}
 }
 
 static void xylonfb_set_fbi_var_screeninfo(struct fb_var_screeninfo *var,
@@ -924,44 +1399,24 @@ static void xylonfb_set_hw_specifics(struct fb_info *fbi,
 				     struct xylonfb_layer_fix_data *fd)
 {
 	struct xylonfb_data *data = ld->data;
+	const struct xylonfb_format *fmt = xylonfb_get_format(fd->format);
+	const struct xylonfb_format *cfmt = xylonfb_get_color_format(fd);
 
 	XYLONFB_DBG(INFO, "%s", __func__);
 
 	fbi->fix.smem_start = ld->fb_pbase;
 	fbi->fix.smem_len = ld->fb_size;
-	if (fd->type == LOGICVC_LAYER_RGB) {
-		fbi->fix.type = FB_TYPE_PACKED_PIXELS;
-	} else if (fd->type == LOGICVC_LAYER_YUV) {
-		if (fd->format == XYLONFB_FORMAT_C8)
-			fbi->fix.type = FB_TYPE_PACKED_PIXELS;
-		else
-			fbi->fix.type = FB_TYPE_FOURCC;
-	}
-	if ((fd->type == LOGICVC_LAYER_YUV) ||
-	    (fd->type == LOGICVC_LAYER_ALPHA)) {
-		if (fd->format == XYLONFB_FORMAT_C8)
-			fbi->fix.visual = FB_VISUAL_PSEUDOCOLOR;
-		else
-			fbi->fix.visual = FB_VISUAL_FOURCC;
-	} else if (fd->format == XYLONFB_FORMAT_C8) {
-		fbi->fix.visual = FB_VISUAL_PSEUDOCOLOR;
-	} else {
-		/*
-		 * Other logiCVC layer pixel formats:
-		 * - 8 bpp: LAYER or PIXEL alpha
-		 *   It is not true color, RGB triplet is stored in 8 bits.
-		 * - 16 bpp:
-		 *   LAYER or PIXEL alpha: RGB triplet is stored in 16 bits
-		 * - 32 bpp: LAYER or PIXEL alpha
-		 *   True color, RGB triplet or ARGB quadriplet
-		 *   is stored in 32 bits.
-		 */
-		fbi->fix.visual = FB_VISUAL_TRUECOLOR;
-	}
+	fbi->fix.type = fmt->type;
+	fbi->fix.visual = fmt->visual;
 
 	fbi->fix.xpanstep = 1;
 	fbi->fix.ypanstep = 1;
 	fbi->fix.ywrapstep = 0;
+	/*
+	 * logiCVC layer line stride is fixed by IP "pixel-stride" parameter and
+	 * can not be programmed, so buffers are packed one after another
+	 * in active mode number of lines using the IP line stride.
+	 */
 	fbi->fix.line_length = fd->width * (fd->bpp / 8);
 	fbi->fix.mmio_start = ld->pbase;
 	fbi->fix.mmio_len = LOGICVC_LAYER_REGISTERS_RANGE;
@@ -972,263 +1427,12 @@ static void xylonfb_set_hw_specifics(struct fb_info *fbi,
 
 	fbi->var.bits_per_pixel = fd->bpp;
 
-	switch (fd->type) {
-	case LOGICVC_LAYER_ALPHA:
-		fbi->var.grayscale = LOGICVC_PIX_FMT_ALPHA;
-		break;
-	case LOGICVC_LAYER_RGB:
-		fbi->var.grayscale = 0;
-		break;
-	case LOGICVC_LAYER_YUV:
-		switch (fd->format){
-		case XYLONFB_FORMAT_C8:
-			fbi->var.grayscale = LOGICVC_PIX_FMT_AYUV;
-			break;
-		case XYLONFB_FORMAT_YUYV:
-			fbi->var.grayscale = V4L2_PIX_FMT_VYUY;
-			break;
-		case XYLONFB_FORMAT_UYVY:
-			fbi->var.grayscale = V4L2_PIX_FMT_VYUY;
-			break;
-		case XYLONFB_FORMAT_AYUV:
-			fbi->var.grayscale = LOGICVC_PIX_FMT_AYUV;
-			break;
-		case XYLONFB_FORMAT_AVUY:
-			fbi->var.grayscale = LOGICVC_PIX_FMT_AVUY;
-			break;
-		case XYLONFB_FORMAT_XYUV:
-			fbi->var.grayscale = LOGICVC_PIX_FMT_XYUV;
-			break;
-		case XYLONFB_FORMAT_XVUY:
-			fbi->var.grayscale = LOGICVC_PIX_FMT_XVUY;
-			break;
-		case XYLONFB_FORMAT_YUYV_121010:
-			fbi->var.grayscale = LOGICVC_PIX_FMT_YUYV_121010;
-		break;
-		case XYLONFB_FORMAT_UYVY_121010:
-			fbi->var.grayscale = LOGICVC_PIX_FMT_UYVY_121010;
-			break;
-		case XYLONFB_FORMAT_XYUV_2101010:
-			fbi->var.grayscale = LOGICVC_PIX_FMT_XYUV_2101010;
-		break;
-		case XYLONFB_FORMAT_XVUY_2101010:
-			fbi->var.grayscale = LOGICVC_PIX_FMT_XYUV_2101010;
-			break;
-		}
-		break;
-	}
-
-	/*
-	 * Set values according to logiCVC layer data width configuration:
-	 * layer data width can be 1, 2, 4 bytes
-	 */
-	if (fd->transparency == LOGICVC_ALPHA_LAYER) {
-		fbi->var.transp.offset = 0;
-		fbi->var.transp.length = 0;
-	}
-
-	switch (fd->format) {
-	case XYLONFB_FORMAT_A8:
-		fbi->var.transp.offset = 0;
-		fbi->var.transp.length = 8;
-		break;
-	case XYLONFB_FORMAT_C8:
-		switch (fd->format_clut) {
-		case XYLONFB_FORMAT_CLUT_ARGB6565:
-			fbi->var.transp.offset = 24;
-			fbi->var.transp.length = 6;
-			fbi->var.red.offset = 19;
-			fbi->var.red.length = 5;
-			fbi->var.green.offset = 10;
-			fbi->var.green.length = 6;
-			fbi->var.blue.offset = 3;
-			fbi->var.blue.length = 5;
-			break;
-		case XYLONFB_FORMAT_CLUT_ARGB8888:
-			fbi->var.transp.offset = 24;
-			fbi->var.transp.length = 8;
-			fbi->var.red.offset = 16;
-			fbi->var.red.length = 8;
-			fbi->var.green.offset = 8;
-			fbi->var.green.length = 8;
-			fbi->var.blue.offset = 0;
-			fbi->var.blue.length = 8;
-			break;
-		case XYLONFB_FORMAT_CLUT_AYUV8888:
-			fbi->var.transp.offset = 24;
-			fbi->var.transp.length = 8;
-			fbi->var.red.offset = 16;
-			fbi->var.red.length = 8;
-			fbi->var.green.offset = 8;
-			fbi->var.green.length = 8;
-			fbi->var.blue.offset = 0;
-			fbi->var.blue.length = 8;
-			break;
-		}
-		break;
-	case XYLONFB_FORMAT_ARGB3332:
-		fbi->var.transp.offset = 8;
-		fbi->var.transp.length = 3;
-	case XYLONFB_FORMAT_RGB332:
-		fbi->var.red.offset = 5;
-		fbi->var.red.length = 3;
-		fbi->var.green.offset = 2;
-		fbi->var.green.length = 3;
-		fbi->var.blue.offset = 0;
-		fbi->var.blue.length = 2;
-		break;
-	case XYLONFB_FORMAT_ARGB565:
-		fbi->var.transp.offset = 24;
-		fbi->var.transp.length = 6;
-	case XYLONFB_FORMAT_RGB565:
-		fbi->var.red.offset = 11;
-		fbi->var.red.length = 5;
-		fbi->var.green.offset = 5;
-		fbi->var.green.length = 6;
-		fbi->var.blue.offset = 0;
-		fbi->var.blue.length = 5;
-		break;
-	case XYLONFB_FORMAT_ARGB8888:
-	case XYLONFB_FORMAT_AYUV:
-		fbi->var.transp.offset = 24;
-		fbi->var.transp.length = 8;
-	case XYLONFB_FORMAT_XRGB8888:
-		fbi->var.red.offset = 16;
-		fbi->var.red.length = 8;
-		fbi->var.green.offset = 8;
-		fbi->var.green.length = 8;
-		fbi->var.blue.offset = 0;
-		fbi->var.blue.length = 8;
-		break;
-	case XYLONFB_FORMAT_ABGR3233:
-		fbi->var.transp.offset = 8;
-		fbi->var.transp.length = 3;
-	case XYLONFB_FORMAT_BGR233:
-		fbi->var.red.offset = 0;
-		fbi->var.red.length = 3;
-		fbi->var.green.offset = 3;
-		fbi->var.green.length = 3;
-		fbi->var.blue.offset = 6;
-		fbi->var.blue.length = 2;
-		break;
-	case XYLONFB_FORMAT_ABGR565:
-		fbi->var.transp.offset = 24;
-		fbi->var.transp.length = 6;
-	case XYLONFB_FORMAT_BGR565:
-		fbi->var.red.offset = 0;
-		fbi->var.red.length = 5;
-		fbi->var.green.offset = 5;
-		fbi->var.green.length = 6;
-		fbi->var.blue.offset = 11;
-		fbi->var.blue.length = 5;
-		break;
-	case XYLONFB_FORMAT_ABGR8888:
-		fbi->var.transp.offset = 24;
-		fbi->var.transp.length = 8;
-	case XYLONFB_FORMAT_XBGR8888:
-		fbi->var.red.offset = 0;
-		fbi->var.red.length = 8;
-		fbi->var.green.offset = 8;
-		fbi->var.green.length = 8;
-		fbi->var.blue.offset = 16;
-		fbi->var.blue.length = 8;
-		break;
-	case XYLONFB_FORMAT_XRGB2101010:
-		fbi->var.red.offset = 20;
-		fbi->var.red.length = 10;
-		fbi->var.green.offset = 10;
-		fbi->var.green.length = 10;
-		fbi->var.blue.offset = 0;
-		fbi->var.blue.length = 10;
-		break;
-	case XYLONFB_FORMAT_XBGR2101010:
-		fbi->var.red.offset = 0;
-		fbi->var.red.length = 10;
-		fbi->var.green.offset = 10;
-		fbi->var.green.length = 10;
-		fbi->var.blue.offset = 20;
-		fbi->var.blue.length = 10;
-		break;
-	case XYLONFB_FORMAT_YUYV:
-		fbi->var.transp.offset = 16;
-		fbi->var.transp.length = 8;
-		fbi->var.red.offset = 0;
-		fbi->var.red.length = 8;
-		fbi->var.green.offset = 8;
-		fbi->var.green.length = 8;
-		fbi->var.blue.offset = 24;
-		fbi->var.blue.length = 8;
-		break;
-	case XYLONFB_FORMAT_UYVY:
-		fbi->var.transp.offset = 24;
-		fbi->var.transp.length = 8;
-		fbi->var.red.offset = 8;
-		fbi->var.red.length = 8;
-		fbi->var.green.offset = 0;
-		fbi->var.green.length = 8;
-		fbi->var.blue.offset = 16;
-		fbi->var.blue.length = 8;
-		break;
-	case XYLONFB_FORMAT_YUYV_121010:
-		fbi->var.transp.offset = 0;
-		fbi->var.transp.length = 10;
-		fbi->var.red.offset = 0;
-		fbi->var.red.length = 10;
-		fbi->var.green.offset = 10;
-		fbi->var.green.length = 10;
-		fbi->var.blue.offset = 10;
-		fbi->var.blue.length = 10;
-		break;
-	case XYLONFB_FORMAT_UYVY_121010:
-		fbi->var.transp.offset = 10;
-		fbi->var.transp.length = 10;
-		fbi->var.red.offset = 10;
-		fbi->var.red.length = 10;
-		fbi->var.green.offset = 0;
-		fbi->var.green.length = 10;
-		fbi->var.blue.offset = 0;
-		fbi->var.blue.length = 10;
-		break;
-	case XYLONFB_FORMAT_XYUV:
-		fbi->var.red.offset = 16;
-		fbi->var.red.length = 8;
-		fbi->var.green.offset = 8;
-		fbi->var.green.length = 8;
-		fbi->var.blue.offset = 0;
-		fbi->var.blue.length = 8;
-		break;
-	case XYLONFB_FORMAT_AVUY:
-		fbi->var.transp.offset = 24;
-		fbi->var.transp.length = 8;
-	case XYLONFB_FORMAT_XVUY:
-		fbi->var.red.offset = 0;
-		fbi->var.red.length = 8;
-		fbi->var.green.offset = 8;
-		fbi->var.green.length = 8;
-		fbi->var.blue.offset = 16;
-		fbi->var.blue.length = 8;
-		break;
-	case XYLONFB_FORMAT_XYUV_2101010:
-		fbi->var.red.offset = 20;
-		fbi->var.red.length = 10;
-		fbi->var.green.offset = 10;
-		fbi->var.green.length = 10;
-		fbi->var.blue.offset = 0;
-		fbi->var.blue.length = 10;
-		break;
-	case XYLONFB_FORMAT_XVUY_2101010:
-		fbi->var.red.offset = 0;
-		fbi->var.red.length = 10;
-		fbi->var.green.offset = 10;
-		fbi->var.green.length = 10;
-		fbi->var.blue.offset = 20;
-		fbi->var.blue.length = 10;
-		break;
-	}
-	fbi->var.transp.msb_right = 0;
-	fbi->var.red.msb_right = 0;
-	fbi->var.green.msb_right = 0;
-	fbi->var.blue.msb_right = 0;
+	/* CLUT layer reports color format of its CLUT entries */
+	fbi->var.grayscale = cfmt->fourcc;
+	fbi->var.transp = cfmt->transp;
+	fbi->var.red = cfmt->red;
+	fbi->var.green = cfmt->green;
+	fbi->var.blue = cfmt->blue;
 	fbi->var.activate = FB_ACTIVATE_NOW;
 	fbi->var.height = 0;
 	fbi->var.width = 0;
@@ -1271,14 +1475,14 @@ static int xylonfb_set_timings(struct fb_info *fbi, int bpp)
 	if ((data->flags & XYLONFB_FLAGS_EDID_VMODE) &&
 	    (data->flags & XYLONFB_FLAGS_EDID_READY)) {
 		if (data->flags & XYLONFB_FLAGS_VMODE_INIT) {
-			rc = fb_find_mode(&fb_var, fbi, xylonfb_mode_option,
+			rc = fb_find_mode(&fb_var, fbi, data->vmode_option,
 					  fbi->monspecs.modedb,
 					  fbi->monspecs.modedb_len,
 					  &xylonfb_vm.vmode, bpp);
 			if (!rc)
 				return -EINVAL;
 		} else {
-			rc = fb_find_mode(&fb_var, fbi, xylonfb_mode_option,
+			rc = fb_find_mode(&fb_var, fbi, data->vmode_option,
 					  fbi->monspecs.modedb,
 					  fbi->monspecs.modedb_len,
 					  &xylonfb_vm.vmode, bpp);
@@ -1305,9 +1509,13 @@ static int xylonfb_set_timings(struct fb_info *fbi, int bpp)
 		XYLONFB_DBG(INFO, "%s exact mode", __func__);
 	}
 	else {
-		XYLONFB_DBG(INFO, "%s fb_find_mode %s ", __func__, xylonfb_mode_option);           
-		rc = fb_find_mode(&fb_var, fbi, xylonfb_mode_option, NULL, 0,
+		XYLONFB_DBG(INFO, "%s fb_find_mode %s", __func__,
+			    data->vmode_option);
+		rc = fb_find_mode(&fb_var, fbi, data->vmode_option, NULL, 0,
 				  &xylonfb_vm.vmode, bpp);
+		if (!xylonfb_cvt_var(data, data->vmode_option, (rc == 1),
+				     &fb_var))
+			rc = 1;
 	}
 	switch (rc) {
 	case 0:
@@ -1319,11 +1527,11 @@ static int xylonfb_set_timings(struct fb_info *fbi, int bpp)
 			xylonfb_vm.vmode.refresh);
 		break;
 	case 1:
-		dev_dbg(fbi->dev, "video mode %s", xylonfb_mode_option);
+		dev_dbg(fbi->dev, "video mode %s", data->vmode_option);
 		break;
 	case 2:
 		dev_warn(fbi->dev, "video mode %s with ignored refresh rate\n",
-			 xylonfb_mode_option);
+			 data->vmode_option);
 		break;
 	case 3:
 		dev_warn(fbi->dev, "default video mode %dx%dM-%d@%d\n",
@@ -1351,12 +1559,7 @@ static int xylonfb_set_timings(struct fb_info *fbi, int bpp)
 	data->vm_active.vmode.vsync_len = fb_var.vsync_len;
 	data->vm_active.vmode.sync = fb_var.sync;
 	data->vm_active.vmode.vmode = fb_var.vmode;
-	data->vm_active.vmode.refresh =
-		DIV_ROUND_CLOSEST((PICOS2KHZ(fb_var.pixclock) * 1000),
-				  ((fb_var.xres + fb_var.left_margin +
-				  fb_var.right_margin + fb_var.hsync_len) *
-				  (fb_var.yres + fb_var.upper_margin +
-				  fb_var.lower_margin + fb_var.vsync_len)));
+	data->vm_active.vmode.refresh = xylonfb_mode_var_refresh(&fb_var);
 	strcpy(data->vm_active.opts_cvt, data->vm.opts_cvt);
 	strcpy(data->vm_active.opts_ext, data->vm.opts_ext);
 	sprintf(data->vm_active.name, "%dx%d%s-%d@%d%s",
@@ -1385,6 +1588,14 @@ static int xylonfb_register_fb(struct fb_info *fbi,
 	XYLONFB_DBG(INFO, "%s", __func__);
 
 	fbi->flags = FBINFO_DEFAULT;
+	/* fbcon scrolls by panning instead of copying whole screen */
+	if (data->flags & (XYLONFB_FLAGS_SIZE_POSITION |
+			   XYLONFB_FLAGS_DYNAMIC_LAYER_ADDRESS))
+		fbi->flags |= FBINFO_HWACCEL_YPAN;
+	/* fbcon copies on screen only if layer is drawn with DMA */
+	if (ld->accel_dma)
+		fbi->flags |= FBINFO_HWACCEL_COPYAREA |
+			      FBINFO_HWACCEL_FILLRECT;
 	fbi->screen_base = (char __iomem *)ld->fb_base;
 	fbi->screen_size = ld->fb_size;
 	fbi->pseudo_palette = kzalloc(sizeof(u32) * XYLONFB_PSEUDO_PALETTE_SIZE,
@@ -1401,6 +1612,9 @@ static int xylonfb_register_fb(struct fb_info *fbi,
 			dev_err(dev, "videomode not set\n");
 	}
 	xylonfb_set_fbi_var_screeninfo(&fbi->var, data);
+	if (ld->buffers > xylonfb_get_max_buffers(fbi))
+		ld->buffers = xylonfb_get_max_buffers(fbi);
+	xylonfb_set_buffers(fbi, ld->buffers);
 	fbi->mode = &data->vm_active.vmode;
 	fbi->mode->name = data->vm_active.name;
 
@@ -1435,6 +1649,32 @@ static void xylonfb_layer_initialize(struct xylonfb_layer_data *ld)
 
 	XYLONFB_DBG(INFO, "%s", __func__);
 
+	/*
+	 * Layer enabled by bootloader is adopted as it is only if it scans out
+	 * from its device tree video memory address
+	 */
+	if ((data->flags & XYLONFB_FLAGS_SEAMLESS_HANDOFF) &&
+	    (reg & LOGICVC_LAYER_CTRL_ENABLE)) {
+		if (!fd->address ||
+		    ((data->flags & XYLONFB_FLAGS_DYNAMIC_LAYER_ADDRESS) &&
+		     (data->reg_access.get_reg_val(ld->base,
+						   LOGICVC_LAYER_ADDR_ROFF,
+						   ld) != ld->fb_pbase))) {
+			dev_info(&data->pdev->dev,
+				 "seamless handoff layer %d mismatch\n",
+				 fd->id);
+			data->flags &= ~XYLONFB_FLAGS_SEAMLESS_HANDOFF;
+		} else {
+			ld->flags |= XYLONFB_FLAGS_LAYER_ENABLED;
+		}
+	}
+
+	ld->clut.bank = (data->reg_access.get_reg_val(data->dev_base,
+						      LOGICVC_CLUT_SELECT_ROFF,
+						      ld) >> fd->id) & 1;
+	ld->clut.hw_valid[0] = false;
+	ld->clut.hw_valid[1] = false;
+
 	reg |= LOGICVC_LAYER_CTRL_COLOR_TRANSPARENCY_DISABLE;
 	if (fd->component_swap)
 		reg |= LOGICVC_LAYER_CTRL_PIXEL_FORMAT_ABGR;
@@ -1456,12 +1696,13 @@ static int xylonfb_vmem_init(struct xylonfb_layer_data *ld, int id, bool *mmap)
 
 	XYLONFB_DBG(INFO, "%s", __func__);
 
+	ld->buffers = fd->buffers;
+
+	ld->fb_size = fd->width * (fd->bpp / 8) * fd->height;
+
 	if (fd->address) {
 		ld->fb_pbase = fd->address;
 
-		xylonfb_get_vmem_height(data, data->layers, id);
-		ld->fb_size = fd->width * (fd->bpp / 8) * fd->height;
-
 		if (*mmap) {
 			ld->fb_base = (__force void *)ioremap_wc(ld->fb_pbase,
 								 ld->fb_size);
@@ -1471,14 +1712,6 @@ static int xylonfb_vmem_init(struct xylonfb_layer_data *ld, int id, bool *mmap)
 			}
 		}
 	} else {
-		if (fd->buffer_offset)
-			fd->height = fd->buffer_offset *
-				     LOGICVC_MAX_LAYER_BUFFERS;
-		else
-			fd->height = XYLONFB_VRES_DEFAULT *
-				     LOGICVC_MAX_LAYER_BUFFERS;
-		ld->fb_size = fd->width * (fd->bpp / 8) * fd->height;
-
 		ld->fb_base = dma_alloc_coherent(&data->pdev->dev,
 						 PAGE_ALIGN(ld->fb_size),
 						 &ld->fb_pbase, GFP_KERNEL);
@@ -1497,27 +1730,108 @@ static int xylonfb_vmem_init(struct xylonfb_layer_data *ld, int id, bool *mmap)
 	return 0;
 }
 
+static const u32 xylonfb_pwr_ctrl[] = {
+	[XYLONFB_POWER_OFF] = 0,
+	[XYLONFB_POWER_VDD] = LOGICVC_EN_VDD_MSK,
+	[XYLONFB_POWER_SIGNAL] = LOGICVC_EN_VDD_MSK | LOGICVC_V_EN_MSK,
+	[XYLONFB_POWER_ON] = LOGICVC_EN_VDD_MSK | LOGICVC_V_EN_MSK |
+			     LOGICVC_EN_BLIGHT_MSK,
+};
+
+/* Delay in ms before entering power state */
+static u32 xylonfb_pwr_delay(struct xylonfb_data *data, u32 state)
+{
+	switch (state) {
+	case XYLONFB_POWER_SIGNAL:
+		return data->pwr_delay;
+	case XYLONFB_POWER_ON:
+		return data->sig_delay;
+	default:
+		return 0;
+	}
+}
+
+/* Called with pwr_mutex held */
+static void xylonfb_pwr_set(struct xylonfb_data *data, u32 state)
+{
+	data->pwr_state = state;
+	data->pwr_time = jiffies;
+	writel(xylonfb_pwr_ctrl[state],
+	       data->dev_base + LOGICVC_POWER_CTRL_ROFF);
+}
+
+/*
+ * Steps power up sequence when delay of the next state has passed since
+ * the last state change, so delays hold however often work is queued.
+ */
+static void xylonfb_pwr_work(struct work_struct *work)
+{
+	struct xylonfb_data *data = container_of(to_delayed_work(work),
+						 struct xylonfb_data,
+						 pwr_work);
+	unsigned long due;
+
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	mutex_lock(&data->pwr_mutex);
+
+	if (data->pwr_state >= data->pwr_target)
+		goto unlock;
+
+	due = data->pwr_time +
+	      msecs_to_jiffies(xylonfb_pwr_delay(data, data->pwr_state + 1));
+	if (time_before(jiffies, due)) {
+		schedule_delayed_work(&data->pwr_work, due - jiffies);
+		goto unlock;
+	}
+
+	xylonfb_pwr_set(data, data->pwr_state + 1);
+
+	if (data->pwr_state < data->pwr_target)
+		schedule_delayed_work(&data->pwr_work,
+			msecs_to_jiffies(xylonfb_pwr_delay(data,
+							   data->pwr_state + 1)));
+
+unlock:
+	mutex_unlock(&data->pwr_mutex);
+}
+
+/*
+ * Display power is switched on in VDD, signals and backlight order with
+ * power and signal delays between the steps. All power up steps are done
+ * by delayed work. Switching off is done immediately. Caller does not
+ * wait for sequence.
+ */
+void xylonfb_pwr_request(struct xylonfb_data *data, u32 state)
+{
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	mutex_lock(&data->pwr_mutex);
+
+	data->pwr_target = state;
+
+	if (state <= data->pwr_state) {
+		cancel_delayed_work(&data->pwr_work);
+		if (state != data->pwr_state)
+			xylonfb_pwr_set(data, state);
+	} else {
+		schedule_delayed_work(&data->pwr_work, 0);
+	}
+
+	mutex_unlock(&data->pwr_mutex);
+}
+
 static void xylonfb_logicvc_disp_ctrl(struct fb_info *fbi, bool enable)
 {
 	struct xylonfb_layer_data *ld = fbi->par;
 	struct xylonfb_data *data = ld->data;
-	void __iomem *dev_base = data->dev_base;
-	u32 val;
 
 	XYLONFB_DBG(INFO, "%s", __func__);
 
-	if (enable) {
-		val = LOGICVC_EN_VDD_MSK;
-		writel(val, dev_base + LOGICVC_POWER_CTRL_ROFF);
-		mdelay(data->pwr_delay);
-		val |= LOGICVC_V_EN_MSK;
-		writel(val, dev_base + LOGICVC_POWER_CTRL_ROFF);
-		mdelay(data->sig_delay);
-		val |= LOGICVC_EN_BLIGHT_MSK;
-		writel(val, dev_base + LOGICVC_POWER_CTRL_ROFF);
-	} else {
-		writel(0, dev_base + LOGICVC_POWER_CTRL_ROFF);
-	}
+	if (enable)
+		xylonfb_pwr_request(data, XYLONFB_POWER_ON);
+	else
+		xylonfb_pwr_request(data, XYLONFB_POWER_OFF);
 }
 
 static void xylonfb_logicvc_layer_enable(struct fb_info *fbi, bool enable)
@@ -1532,7 +1846,12 @@ static void xylonfb_logicvc_layer_enable(struct fb_info *fbi, bool enable)
 					       ld);
 
 	if (enable) {
-		reg |= LOGICVC_LAYER_CTRL_ENABLE;
+		if (!(ld->flags & XYLONFB_FLAGS_LAYER_BLANKED))
+			reg |= LOGICVC_LAYER_CTRL_ENABLE;
+		if (ld->data->vm_active.vmode.vmode & FB_VMODE_INTERLACED)
+			reg |= LOGICVC_LAYER_CTRL_INTERLACE;
+		else
+			reg &= ~LOGICVC_LAYER_CTRL_INTERLACE;
 		ld->flags |= XYLONFB_FLAGS_LAYER_ENABLED;
 	} else {
 		reg &= ~LOGICVC_LAYER_CTRL_ENABLE;
@@ -1544,6 +1863,35 @@ static void xylonfb_logicvc_layer_enable(struct fb_info *fbi, bool enable)
 					 ld);
 }
 
+/*
+ * Blanked layer is hidden by disabling it in logiCVC, leaving layer
+ * video memory intact. Enabled state is restored on unblank.
+ */
+static void xylonfb_logicvc_layer_blank(struct fb_info *fbi, bool blank)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	u32 reg;
+
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	reg = ld->data->reg_access.get_reg_val(ld->base,
+					       LOGICVC_LAYER_CTRL_ROFF,
+					       ld);
+
+	if (blank) {
+		reg &= ~LOGICVC_LAYER_CTRL_ENABLE;
+		ld->flags |= XYLONFB_FLAGS_LAYER_BLANKED;
+	} else {
+		if (ld->flags & XYLONFB_FLAGS_LAYER_ENABLED)
+			reg |= LOGICVC_LAYER_CTRL_ENABLE;
+		ld->flags &= ~XYLONFB_FLAGS_LAYER_BLANKED;
+	}
+
+	ld->data->reg_access.set_reg_val(reg, ld->base,
+					 LOGICVC_LAYER_CTRL_ROFF,
+					 ld);
+}
+
 static void xylonfb_enable_logicvc_output(struct fb_info *fbi)
 {
 	struct xylonfb_layer_data *ld = fbi->par;
@@ -1557,13 +1905,23 @@ static void xylonfb_enable_logicvc_output(struct fb_info *fbi)
 	writel(vm->hsync_len - 1, dev_base + LOGICVC_HSYNC_ROFF);
 	writel(vm->left_margin - 1, dev_base + LOGICVC_HSYNC_BACK_PORCH_ROFF);
 	writel(vm->xres - 1, dev_base + LOGICVC_HRES_ROFF);
-	writel(vm->lower_margin - 1, dev_base + LOGICVC_VSYNC_FRONT_PORCH_ROFF);
-	writel(vm->vsync_len - 1, dev_base + LOGICVC_VSYNC_ROFF);
-	writel(vm->upper_margin - 1, dev_base + LOGICVC_VSYNC_BACK_PORCH_ROFF);
-	writel(vm->yres - 1, dev_base + LOGICVC_VRES_ROFF);
+	writel(xylonfb_field_lines(vm, vm->lower_margin) - 1,
+	       dev_base + LOGICVC_VSYNC_FRONT_PORCH_ROFF);
+	writel(xylonfb_field_lines(vm, vm->vsync_len) - 1,
+	       dev_base + LOGICVC_VSYNC_ROFF);
+	writel(xylonfb_field_lines(vm, vm->upper_margin) - 1,
+	       dev_base + LOGICVC_VSYNC_BACK_PORCH_ROFF);
+	writel(xylonfb_field_lines(vm, vm->yres) - 1,
+	       dev_base + LOGICVC_VRES_ROFF);
 	data->reg_access.set_reg_val(data->vm_active.ctrl, dev_base,
 				     LOGICVC_CTRL_ROFF, ld);
 
+	/* logiCVC starts scanning out with top field */
+	if (vm->vmode & FB_VMODE_INTERLACED)
+		data->vsync.field = XYLONFB_FIELD_BOTTOM;
+	else
+		data->vsync.field = XYLONFB_FIELD_TOP;
+
 	if (data->flags & XYLONFB_FLAGS_BACKGROUND_LAYER_YUV)
 		data->reg_access.set_reg_val(LOGICVC_COLOR_YUV888_BLACK,
 					     dev_base,
@@ -1611,6 +1969,8 @@ static void xylonfb_start(struct fb_info **afbi, int layers)
 	struct fb_info *fbi = afbi[0];
 	struct xylonfb_layer_data *ld = fbi->par;
 	struct xylonfb_data *data = ld->data;
+	unsigned long flags;
+	u32 int_mask;
 	int i;
 
 	XYLONFB_DBG(INFO, "%s", __func__);
@@ -1623,13 +1983,21 @@ static void xylonfb_start(struct fb_info **afbi, int layers)
 		xylonfb_logicvc_layer_enable(afbi[i], false);
 	}
 
-	if (data->flags & XYLONFB_FLAGS_VSYNC_IRQ) {
-		writel(LOGICVC_INT_V_SYNC,
-		       data->dev_base + LOGICVC_INT_STAT_ROFF);
-		data->reg_access.set_reg_val(~LOGICVC_INT_V_SYNC,
-					     data->dev_base,
-					     LOGICVC_INT_MASK_ROFF, ld);
+	int_mask = ~LOGICVC_INT_FIFO_UNDERRUN;
+	if ((data->flags & XYLONFB_FLAGS_VSYNC_IRQ) ||
+	    (data->vm_active.vmode.vmode & FB_VMODE_INTERLACED))
+		int_mask &= ~LOGICVC_INT_V_SYNC;
+	for (i = 0; i < layers; i++) {
+		ld = afbi[i]->par;
+		if (ld->fd->format == XYLONFB_FORMAT_C8)
+			int_mask &= ~(LOGICVC_INT_L0_CLUT_SW << i);
 	}
+	spin_lock_irqsave(&data->irq_lock, flags);
+	data->underrun_rearm = true;
+	writel(~int_mask, data->dev_base + LOGICVC_INT_STAT_ROFF);
+	data->reg_access.set_reg_val(int_mask, data->dev_base,
+				     LOGICVC_INT_MASK_ROFF, ld);
+	spin_unlock_irqrestore(&data->irq_lock, flags);
 
 	for (i = 0; i < layers; i++) {
 		ld = afbi[i]->par;
@@ -1658,6 +2026,7 @@ static void xylonfb_start(struct fb_info **afbi, int layers)
 static void xylonfb_get_vmode_opts(struct xylonfb_data *data)
 {
 	char *s, *opt, *ext, *c;
+	bool interlaced;
 
 	XYLONFB_DBG(INFO, "%s", __func__);
 
@@ -1665,6 +2034,10 @@ static void xylonfb_get_vmode_opts(struct xylonfb_data *data)
 	    (data->flags & XYLONFB_FLAGS_EDID_READY))
 		return;
 
+	/* display-timings video mode can be interlaced */
+	interlaced = (data->flags & XYLONFB_FLAGS_VMODE_CUSTOM) &&
+		     (data->vm.vmode.vmode & FB_VMODE_INTERLACED);
+
 	s = data->vm.name;
 	opt = data->vm.opts_cvt;
 	ext = data->vm.opts_ext;
@@ -1678,8 +2051,8 @@ static void xylonfb_get_vmode_opts(struct xylonfb_data *data)
 	if (c)
 		*opt = *c;
 	c = strchr(s, 'i');
-	if (c) {
-		*ext++ = *c;
+	if (c || interlaced) {
+		*ext++ = 'i';
 		data->vm.vmode.vmode |= FB_VMODE_INTERLACED;
 	}
 	c = strchr(s, 'm');
@@ -1691,41 +2064,7 @@ static bool xylonfb_allow_console(struct xylonfb_layer_fix_data *fd)
 {
 	XYLONFB_DBG(INFO, "%s", __func__);
 
-	switch (fd->format) {
-	case XYLONFB_FORMAT_A8:
-	case XYLONFB_FORMAT_C8:
-	case XYLONFB_FORMAT_RGB332:
-	case XYLONFB_FORMAT_RGB565:
-	case XYLONFB_FORMAT_XRGB8888:
-	case XYLONFB_FORMAT_ARGB8888:
-	case XYLONFB_FORMAT_BGR233:
-	case XYLONFB_FORMAT_ARGB3332:
-	case XYLONFB_FORMAT_ABGR3233:
-	case XYLONFB_FORMAT_ARGB565:
-	case XYLONFB_FORMAT_ABGR565:
-	case XYLONFB_FORMAT_BGR565:
-	case XYLONFB_FORMAT_XBGR8888:
-	case XYLONFB_FORMAT_ABGR8888:
-	case XYLONFB_FORMAT_XRGB2101010:
-	case XYLONFB_FORMAT_XBGR2101010:
-/* packed YCbCr 4:2:2, 32bit for 2 pixels. 8bit color component */
-	case XYLONFB_FORMAT_YUYV:
-	case XYLONFB_FORMAT_UYVY:
-/* packed YCbCr 4:2:2, 64bit for 2 pixels, 10bit color component */
-	case XYLONFB_FORMAT_YUYV_121010:
-	case XYLONFB_FORMAT_UYVY_121010:
-/* packed YCbCr 4:4:4, 32bit for 1 pixel, 8bit color component */
-	case XYLONFB_FORMAT_AYUV:
-	case XYLONFB_FORMAT_AVUY:
-	case XYLONFB_FORMAT_XYUV:
-	case XYLONFB_FORMAT_XVUY:
-/* packed YCbCr 4:4:4, 32bit for 1 pixel, 10bit color component */
-	case XYLONFB_FORMAT_XYUV_2101010:
-	case XYLONFB_FORMAT_XVUY_2101010:
-		return true;
-	default:
-		return false;
-	}
+	return xylonfb_get_format(fd->format)->console;
 }
 
 int xylonfb_init_core(struct xylonfb_data *data)
@@ -1734,7 +2073,8 @@ int xylonfb_init_core(struct xylonfb_data *data)
 	struct fb_info **afbi, *fbi;
 	struct xylonfb_layer_data *ld;
 	void __iomem *dev_base;
-	u32 ip_ver;
+	u32 ip_ver, power;
+	unsigned long flags;
 	int i, ret, layers, console_layer;
 	int regfb[LOGICVC_MAX_LAYERS];
 	size_t size;
@@ -1793,6 +2133,10 @@ int xylonfb_init_core(struct xylonfb_data *data)
 		dev_err(dev, "no available layers\n");
 		return -ENODEV;
 	}
+	ret = xylonfb_vmem_plan(data);
+	if (ret)
+		return ret;
+
 	console_layer = data->console_layer;
 	if (console_layer >= layers) {
 		dev_err(dev, "invalid console layer ID\n");
@@ -1823,40 +2167,67 @@ int xylonfb_init_core(struct xylonfb_data *data)
 		data->reg_access.set_reg_val = xylonfb_set_reg_mem;
 	}
 
-	data->coeff.cyr = LOGICVC_COEFF_Y_R;
-	data->coeff.cyg = LOGICVC_COEFF_Y_G;
-	data->coeff.cyb = LOGICVC_COEFF_Y_B;
-	if (data->flags & XYLONFB_FLAGS_DISPLAY_INTERFACE_ITU656) {
-		data->coeff.cy = LOGICVC_COEFF_ITU656_Y;
-		data->coeff.cur = LOGICVC_COEFF_ITU656_U_R;
-		data->coeff.cug = LOGICVC_COEFF_ITU656_U_G;
-		data->coeff.cub = LOGICVC_COEFF_ITU656_U_B;
-		data->coeff.cvr = LOGICVC_COEFF_ITU656_V_R;
-		data->coeff.cvg = LOGICVC_COEFF_ITU656_V_G;
-		data->coeff.cvb = LOGICVC_COEFF_ITU656_V_B;
-	} else {
-		data->coeff.cy = LOGICVC_COEFF_Y;
-		data->coeff.cur = LOGICVC_COEFF_U_R;
-		data->coeff.cug = LOGICVC_COEFF_U_G;
-		data->coeff.cub = LOGICVC_COEFF_U_B;
-		data->coeff.cvr = LOGICVC_COEFF_V_R;
-		data->coeff.cvg = LOGICVC_COEFF_V_G;
-		data->coeff.cvb = LOGICVC_COEFF_V_B;
+	ret = xylonfb_set_color_space(data, data->color_space,
+				      data->color_range);
+	if (ret) {
+		dev_err(dev, "failed set color space\n");
+		return ret;
+	}
+
+	if (data->flags & XYLONFB_FLAGS_SEAMLESS_HANDOFF) {
+		if (!(data->flags & XYLONFB_FLAGS_READABLE_REGS)) {
+			dev_warn(dev, "seamless handoff needs readable regs\n");
+			data->flags &= ~XYLONFB_FLAGS_SEAMLESS_HANDOFF;
+		} else if ((readl(dev_base + LOGICVC_POWER_CTRL_ROFF) &
+			    (LOGICVC_EN_VDD_MSK | LOGICVC_V_EN_MSK)) !=
+			   (LOGICVC_EN_VDD_MSK | LOGICVC_V_EN_MSK)) {
+			dev_info(dev, "seamless handoff display not powered\n");
+			data->flags &= ~XYLONFB_FLAGS_SEAMLESS_HANDOFF;
+		}
 	}
 
 	atomic_set(&data->refcount, 0);
 
+	init_waitqueue_head(&data->clut_wait);
+	spin_lock_init(&data->clut_lock);
+	spin_lock_init(&data->flip_lock);
+	spin_lock_init(&data->irq_lock);
+	INIT_DELAYED_WORK(&data->underrun_work, xylonfb_underrun_work);
+	atomic_set(&data->underruns, 0);
+
+	mutex_init(&data->vmode_mutex);
+	mutex_init(&data->pwr_mutex);
+	INIT_DELAYED_WORK(&data->pwr_work, xylonfb_pwr_work);
+	data->pwr_state = XYLONFB_POWER_OFF;
+	if (data->flags & XYLONFB_FLAGS_SEAMLESS_HANDOFF) {
+		power = readl(dev_base + LOGICVC_POWER_CTRL_ROFF);
+		for (i = XYLONFB_POWER_ON; i > XYLONFB_POWER_OFF; i--) {
+			if ((power & xylonfb_pwr_ctrl[i]) ==
+			    xylonfb_pwr_ctrl[i])
+				break;
+		}
+		data->pwr_state = i;
+	}
+	data->pwr_target = data->pwr_state;
+	data->pwr_time = jiffies;
+
+	xylonfb_accel_init(data);
+
+	ret = xylonfb_mode_init(data);
+	if (ret)
+		goto err_probe;
+
 	data->flags |= XYLONFB_FLAGS_VMODE_INIT;
 
 	sprintf(data->vm.name, "%s-%d@%d",
 		data->vm.name, data->fd[console_layer]->bpp,
 		data->vm.vmode.refresh);
 	if (!(data->flags & XYLONFB_FLAGS_VMODE_CUSTOM))
-		xylonfb_mode_option = data->vm.name;
+		data->vmode_option = data->vm.name;
 	xylonfb_get_vmode_opts(data);
 
-	if (data->pixel_clock) {
-		if (xylonfb_hw_pixclk_supported(dev, data->pixel_clock)) {
+	if (data->pixel_clock.dn) {
+		if (xylonfb_hw_pixclk_supported(data)) {
 			data->flags |= XYLONFB_FLAGS_PIXCLK_VALID;
 		} else {
 			dev_warn(dev, "pixel clock not supported\n");
@@ -1909,6 +2280,17 @@ int xylonfb_init_core(struct xylonfb_data *data)
 		if (ret)
 			goto err_probe;
 
+		xylonfb_accel_map(fbi);
+
+		ld->accel_line_size = ld->fd->width * (ld->fd->bpp / 8);
+		ld->accel_line = devm_kzalloc(dev, ld->accel_line_size,
+					      GFP_KERNEL);
+		if (!ld->accel_line) {
+			dev_err(dev, "failed allocate drawing line buffer\n");
+			ret = -ENOMEM;
+			goto err_probe;
+		}
+
 		xylonfb_layer_initialize(ld);
 
 		ret = xylonfb_register_fb(fbi, ld, i, &regfb[i]);
@@ -1938,6 +2320,15 @@ int xylonfb_init_core(struct xylonfb_data *data)
 		}
 	}
 
+	/* Video mode index starts with EDID modes or initial video mode */
+	if (ld) {
+		xylonfb_mode_update(data, &afbi[0]->monspecs);
+		if (!data->mode_db.edid &&
+		    !(data->flags & XYLONFB_FLAGS_PUT_VSCREENINFO_EXACT))
+			xylonfb_mode_add(data, &data->vm_active.vmode,
+					 xylonfb_mode_flags(&data->vm_active));
+	}
+
 	if (ld) {
 		if (!(data->flags & XYLONFB_FLAGS_READABLE_REGS))
 			data->reg_access.set_reg_val(0xFFFF, dev_base,
@@ -1958,15 +2349,29 @@ int xylonfb_init_core(struct xylonfb_data *data)
 
 	dev_set_drvdata(dev, (void *)afbi);
 
+#if defined(CONFIG_DEBUG_FS)
+	xylonfb_debugfs_init(data);
+#endif
+
 	data->flags &= ~(XYLONFB_FLAGS_VMODE_INIT |
-			 XYLONFB_FLAGS_VMODE_DEFAULT | XYLONFB_FLAGS_VMODE_SET);
-	xylonfb_mode_option = NULL;
+			 XYLONFB_FLAGS_VMODE_DEFAULT | XYLONFB_FLAGS_VMODE_SET |
+			 XYLONFB_FLAGS_SEAMLESS_HANDOFF);
+	data->vmode_option = NULL;
 
 	xylonfb_start(afbi, layers);
 
 	return 0;
 
 err_probe:
+	/* registered layers may have started display power sequence */
+	cancel_delayed_work_sync(&data->pwr_work);
+	spin_lock_irqsave(&data->irq_lock, flags);
+	data->underrun_rearm = false;
+	spin_unlock_irqrestore(&data->irq_lock, flags);
+	cancel_delayed_work_sync(&data->underrun_work);
+
+	xylonfb_accel_deinit(data, afbi);
+
 	for (i = layers - 1; i >= 0; i--) {
 		fbi = afbi[i];
 		if (!fbi)
@@ -2003,6 +2408,7 @@ int xylonfb_deinit_core(struct platform_device *pdev)
 	struct fb_info *fbi = afbi[0];
 	struct xylonfb_layer_data *ld = fbi->par;
 	struct xylonfb_data *data = ld->data;
+	unsigned long flags;
 	int i;
 
 	XYLONFB_DBG(INFO, "%s", __func__);
@@ -2012,13 +2418,27 @@ int xylonfb_deinit_core(struct platform_device *pdev)
 		return -EINVAL;
 	}
 
+#if defined(CONFIG_DEBUG_FS)
+	xylonfb_debugfs_deinit(data);
+#endif
+
+	cancel_delayed_work_sync(&data->pwr_work);
+
+	/* underrun interrupt may still come, but is not unmasked again */
+	spin_lock_irqsave(&data->irq_lock, flags);
+	data->underrun_rearm = false;
+	spin_unlock_irqrestore(&data->irq_lock, flags);
+	cancel_delayed_work_sync(&data->underrun_work);
+
 	xylonfb_disable_logicvc_output(fbi);
 
 #if defined(CONFIG_FB_XYLON_MISC)
 	xylonfb_misc_deinit(fbi);
 #endif
 
-	xylonfb_hw_pixclk_unload(data->pixel_clock);
+	xylonfb_hw_pixclk_unload(data);
+
+	xylonfb_accel_deinit(data, afbi);
 
 	for (i = data->layers - 1; i >= 0; i--) {
 		fbi = afbi[i];
@@ -17,9 +17,13 @@
 #ifndef __XYLONFB_CORE_H__
 #define __XYLONFB_CORE_H__
 
+#include <linux/dmaengine.h>
 #include <linux/fb.h>
+#include <linux/hashtable.h>
 #include <linux/mutex.h>
+#include <linux/spinlock.h>
 #include <linux/wait.h>
+#include <linux/workqueue.h>
 
 #if defined(CONFIG_FB_XYLON_MISC)
 #include "xylonfb_misc.h"
@@ -45,6 +49,17 @@
 #endif
 
 #define LOGICVC_MAX_LAYERS	5
+#define XYLONFB_MAX_LAYER_BUFFERS	8
+#define XYLONFB_BURST_SIZE_DEFAULT	128
+
+/* CVT reduced blanking version */
+#define XYLONFB_CVT_RB_NONE	0
+#define XYLONFB_CVT_RB_V1	1
+#define XYLONFB_CVT_RB_V2	2
+#define XYLONFB_CVT_RB_DEFAULT	XYLONFB_CVT_RB_V1
+
+#define XYLONFB_CLUT_SIZE		256
+#define XYLONFB_CLUT_BANKS		2
 
 #define XYLONFB_EDID_SIZE	256
 #define XYLONFB_EDID_WAIT_TOUT	60
@@ -73,6 +88,8 @@
 #define XYLONFB_FLAGS_ADV7511_SKIP		(1 << 20)
 #define XYLONFB_FLAGS_ACTIVATE_NEXT_OPEN	(1 << 21)
 #define XYLONFB_FLAGS_PUT_VSCREENINFO_EXACT	(1 << 22)
+#define XYLONFB_FLAGS_SEAMLESS_HANDOFF		(1 << 23)
+#define XYLONFB_FLAGS_LAYER_BLANKED		(1 << 24)
 
 /* Xylon FB driver color formats */
 enum xylonfb_color_format {
@@ -120,19 +137,68 @@ struct xylonfb_data;
 #define VMODE_NAME_SIZE	21
 #define VMODE_OPTS_SIZE	3
 
+/* Video mode index */
+#define XYLONFB_MODE_HASH_BITS	4
+#define XYLONFB_MODE_DB_SIZE	64
+/* Hz, refresh rate difference of video mode found in index */
+#define XYLONFB_MODE_REFRESH_TOLERANCE	1
+
+#define XYLONFB_MODE_CVT		(1 << 0)
+#define XYLONFB_MODE_CVT_RB		(1 << 1)
+#define XYLONFB_MODE_INTERLACED		(1 << 2)
+#define XYLONFB_MODE_MARGINS		(1 << 3)
+
+/* Video mode set differences */
+/* Max V front porch change fitting video mode to pixel clock */
+#define XYLONFB_VMODE_FIT_LINES		4
+
+#define XYLONFB_VMODE_DIFF_PIXCLK	(1 << 0)
+#define XYLONFB_VMODE_DIFF_PORCHES	(1 << 1)
+#define XYLONFB_VMODE_DIFF_TIMINGS	(1 << 2)
+
 struct xylonfb_vmode {
 	u32 ctrl;
 	struct fb_videomode vmode;
+	/* Pixel clock and refresh rate of timings fitted to pixel clock */
+	unsigned long pixclk_khz;
+	u32 refresh_mhz;
 	char name[VMODE_NAME_SIZE];
 	char opts_cvt[VMODE_OPTS_SIZE];
 	char opts_ext[VMODE_OPTS_SIZE];
 };
 
+struct xylonfb_mode {
+	struct hlist_node node;
+	struct fb_videomode vmode;
+	/* resolution, XYLONFB_MODE_* mode options, derived pixel clock */
+	u32 key;
+	u32 flags;
+	u32 pixclk_khz;
+};
+
+struct xylonfb_mode_db {
+	DECLARE_HASHTABLE(hash, XYLONFB_MODE_HASH_BITS);
+	struct xylonfb_mode *modes;
+	struct xylonfb_mode *preferred;
+	/* EDID mode database index is built from */
+	const struct fb_videomode *edid;
+	u32 count;
+};
+
+struct xylonfb_pixclk {
+	struct device_node *dn;
+	struct clk *clk;
+	/* last set frequency, set requests of it are skipped */
+	unsigned long rate_khz;
+};
+
 struct xylonfb_registers {
 	u32 ctrl;
 	u32 dtype;
 	u32 bg;
-	u32 unused[3];
+	u32 unused_0;
+	u32 clut_sel;
+	u32 unused_1;
 	u32 int_mask;
 };
 
@@ -166,6 +232,26 @@ struct xylonfb_register_access {
 			    struct xylonfb_layer_data *layer_data);
 };
 
+/*
+ * Pixel format description
+ * For CLUT formats, color components describe CLUT entry.
+ */
+struct xylonfb_format {
+	u32 bpp;
+	u32 type;
+	u32 visual;
+	u32 fourcc;
+	struct fb_bitfield transp;
+	struct fb_bitfield red;
+	struct fb_bitfield green;
+	struct fb_bitfield blue;
+	/* Packs color components to pseudo palette or CLUT entry */
+	u32 (*pack)(struct fb_info *fbi, u16 t, u16 r, u16 g, u16 b);
+	bool console;
+	/* YUV 4:2:2 formats have even horizontal offset */
+	bool yuv422;
+};
+
 struct xylonfb_layer_fix_data {
 	unsigned int id;
 	u32 address;
@@ -178,9 +264,34 @@ struct xylonfb_layer_fix_data {
 	u32 format_clut;
 	u32 transparency;
 	u32 type;
+	u32 buffers;
+	/* Memory plan: bytes of partially used burst */
+	u32 line_padding;
+	u32 buffer_padding;
 	bool component_swap;
 };
 
+/*
+ * Layer CLUT is updated in inactive bank and banks are switched
+ * on the next frame. Each bank has a shadow copy of its contents,
+ * so only entries differing from the palette are written.
+ */
+struct xylonfb_clut {
+	u32 val[XYLONFB_CLUT_SIZE];
+	u32 hw[XYLONFB_CLUT_BANKS][XYLONFB_CLUT_SIZE];
+	bool hw_valid[XYLONFB_CLUT_BANKS];
+	u32 bank;
+	bool switching;
+};
+
+/* Color set in RGB, kept for conversion to YUV on color space change */
+struct xylonfb_color {
+	u16 r;
+	u16 g;
+	u16 b;
+	bool valid;
+};
+
 struct xylonfb_layer_data {
 	struct mutex mutex;
 
@@ -200,6 +311,20 @@ struct xylonfb_layer_data {
 
 	dma_addr_t fb_pbase_active;
 
+	struct xylonfb_clut clut;
+	struct xylonfb_color transp_color;
+
+	void *accel_line;
+	u32 accel_line_size;
+	/* Video memory mapped for drawing DMA, 0 if not mapped */
+	dma_addr_t accel_dma;
+
+	/* Pan deferred to frame start in interlaced video mode */
+	u32 flip_xoffset;
+	u32 flip_yoffset;
+	bool flip_pending;
+
+	u32 buffers;
 	u32 flags;
 };
 
@@ -208,24 +333,37 @@ struct xylonfb_rgb2yuv_coeff {
 	s32 cyr;
 	s32 cyg;
 	s32 cyb;
+	s32 cu;
 	s32 cur;
 	s32 cug;
 	s32 cub;
+	s32 cv;
 	s32 cvr;
 	s32 cvg;
 	s32 cvb;
 };
 
+#define XYLONFB_YUV_LUT_SIZE	256
+
+/* Per component products of RGB to YUV conversion coefficients */
+struct xylonfb_rgb2yuv_lut {
+	s32 y[3][XYLONFB_YUV_LUT_SIZE];
+	s32 u[3][XYLONFB_YUV_LUT_SIZE];
+	s32 v[3][XYLONFB_YUV_LUT_SIZE];
+};
+
+/* V sync is counted per field in interlaced video mode */
 struct xylonfb_sync {
 	wait_queue_head_t wait;
 	unsigned int count;
+	unsigned int field;
 };
 
 struct xylonfb_data {
 	struct platform_device *pdev;
 
 	struct device_node *device;
-	struct device_node *pixel_clock;
+	struct xylonfb_pixclk pixel_clock;
 
 	struct resource resource_mem;
 	struct resource resource_irq;
@@ -233,22 +371,65 @@ struct xylonfb_data {
 	void __iomem *dev_base;
 
 	struct mutex irq_mutex;
+	/* Interrupt mask read-modify-write, also from interrupt handler */
+	spinlock_t irq_lock;
+	/* Video mode set, mode option used by it and mode index */
+	struct mutex vmode_mutex;
+	const char *vmode_option;
+	char vmode_opt[VMODE_NAME_SIZE];
+	/* Display power sequence, XYLONFB_POWER_* states */
+	struct mutex pwr_mutex;
+	struct delayed_work pwr_work;
+	u32 pwr_state;
+	u32 pwr_target;
+	/* jiffies of the last power state change */
+	unsigned long pwr_time;
+	/* Optional drawing DMA channel, last submitted transfer */
+	struct dma_chan *blit_chan;
+	spinlock_t blit_lock;
+	wait_queue_head_t blit_wait;
+	dma_cookie_t blit_cookie;
+	/* Deferred layer pans */
+	spinlock_t flip_lock;
 
 	struct xylonfb_register_access reg_access;
 	struct xylonfb_sync vsync;
+	wait_queue_head_t clut_wait;
+	/* CLUT bank switch state of all layers */
+	spinlock_t clut_lock;
 	struct xylonfb_vmode vm;
 	struct xylonfb_vmode vm_active;
+	struct xylonfb_mode_db mode_db;
 	struct xylonfb_rgb2yuv_coeff coeff;
+	struct xylonfb_rgb2yuv_lut yuv_lut;
+	struct xylonfb_color bg_color;
 
 	struct xylonfb_layer_fix_data *fd[LOGICVC_MAX_LAYERS];
 	struct xylonfb_registers regs;
 #if defined(CONFIG_FB_XYLON_MISC)
 	struct xylonfb_misc_data misc;
 #endif
+#if defined(CONFIG_DEBUG_FS)
+	struct dentry *debugfs;
+#endif
 
 	u32 bg_layer_bpp;
 	u32 console_layer;
 	u32 pixel_stride;
+	u32 burst_size;
+	/* Memory bandwidth budget in MB/s, 0 if not checked */
+	u32 mem_bw;
+	/*
+	 * FIFO underrun count. Underrun interrupt is masked when it comes,
+	 * and unmasked again by delayed work while rearm is allowed.
+	 */
+	atomic_t underruns;
+	struct delayed_work underrun_work;
+	bool underrun_rearm;
+	/* CVT reduced blanking version used for generated video modes */
+	u32 cvt_rb;
+	u32 color_space;
+	u32 color_range;
 
 	atomic_t refcount;
 
@@ -273,19 +454,97 @@ struct xylonfb_data {
 	u32 max_v_res;
 };
 
-/* Xylon FB video mode options */
-extern char *xylonfb_mode_option;
+/* Xylon FB video mode index functions */
+extern int xylonfb_mode_init(struct xylonfb_data *data);
+extern void xylonfb_mode_update(struct xylonfb_data *data,
+				const struct fb_monspecs *monspecs);
+extern const struct xylonfb_mode *xylonfb_mode_add(struct xylonfb_data *data,
+					const struct fb_videomode *vm,
+					u32 flags);
+extern const struct xylonfb_mode *xylonfb_mode_find(struct xylonfb_data *data,
+					u32 xres, u32 yres, u32 refresh,
+					u32 flags);
+extern u32 xylonfb_mode_flags(const struct xylonfb_vmode *vm);
+extern u32 xylonfb_mode_var_refresh(const struct fb_var_screeninfo *var);
+extern u32 xylonfb_mode_fit(const struct fb_videomode *vm,
+			    unsigned long round_khz,
+			    u32 *htotal_fit, u32 *vtotal_fit);
+
+/* Xylon FB CVT timing generator functions */
+extern int xylonfb_cvt_mode(struct fb_videomode *vm, u32 xres, u32 yres,
+			    u32 refresh, u32 rb);
+extern int xylonfb_cvt_var(struct xylonfb_data *data, const char *option,
+			   bool exact, struct fb_var_screeninfo *var);
 
 /* Xylon FB core pixel clock interface functions */
-extern bool xylonfb_hw_pixclk_supported(struct device *dev,
-					struct device_node *dn);
-extern void xylonfb_hw_pixclk_unload(struct device_node *dn);
-extern int xylonfb_hw_pixclk_set(struct device *dev, struct device_node *dn,
+extern bool xylonfb_hw_pixclk_supported(struct xylonfb_data *data);
+extern void xylonfb_hw_pixclk_unload(struct xylonfb_data *data);
+extern int xylonfb_hw_pixclk_set(struct xylonfb_data *data,
 				 unsigned long pixclk_khz);
-
-/* Xylon FB core V sync wait function */
+extern int xylonfb_hw_pixclk_round(struct xylonfb_data *data,
+				   unsigned long pixclk_khz,
+				   unsigned long *round_khz);
+
+/* Xylon FB pixel format functions */
+extern const struct xylonfb_format *xylonfb_get_format(u32 format);
+extern const struct xylonfb_format *
+xylonfb_get_color_format(struct xylonfb_layer_fix_data *fd);
+extern int xylonfb_set_color_space(struct xylonfb_data *data, u32 space,
+				   u32 range);
+extern u32 xylonfb_rgb2yuv(struct xylonfb_data *data, u8 r, u8 g, u8 b);
+extern u32 xylonfb_rgb2yuv_10(struct xylonfb_data *data, u16 r, u16 g, u16 b);
+
+/* Xylon FB core display power function */
+extern void xylonfb_pwr_request(struct xylonfb_data *data, u32 state);
+
+/* Xylon FB drawing functions */
+extern void xylonfb_fillrect(struct fb_info *fbi,
+			     const struct fb_fillrect *rect);
+extern void xylonfb_copyarea(struct fb_info *fbi,
+			     const struct fb_copyarea *area);
+extern void xylonfb_imageblit(struct fb_info *fbi,
+			      const struct fb_image *image);
+extern int xylonfb_sync(struct fb_info *fbi);
+extern void xylonfb_accel_sync(struct xylonfb_data *data, bool sleep);
+extern void xylonfb_accel_init(struct xylonfb_data *data);
+extern void xylonfb_accel_map(struct fb_info *fbi);
+extern void xylonfb_accel_deinit(struct xylonfb_data *data,
+				 struct fb_info **afbi);
+
+/* Xylon FB memory bandwidth functions */
+extern u32 xylonfb_bw_layer_width(struct xylonfb_layer_data *ld, u32 xres);
+extern u64 xylonfb_bw_layer(struct xylonfb_layer_data *ld,
+			    const struct fb_var_screeninfo *var, u32 width);
+extern u64 xylonfb_bw_demand(struct xylonfb_data *data,
+			     const struct fb_var_screeninfo *var,
+			     struct xylonfb_layer_data *ld, u32 width);
+extern int xylonfb_bw_check(struct fb_info *fbi,
+			    const struct fb_var_screeninfo *var, u32 width,
+			    bool warn);
+
+/* Xylon FB configuration test functions */
+struct xylonfb_config;
+extern int xylonfb_config_test_var(struct fb_info *fbi,
+				   const struct fb_var_screeninfo *var);
+extern int xylonfb_config_test(struct fb_info *fbi,
+			       struct xylonfb_config *config);
+
+/* Xylon FB core V sync functions */
+extern void xylonfb_vsync_ctrl(struct fb_info *fbi, bool enable);
 extern int xylonfb_vsync_wait(u32 crt, struct fb_info *fbi);
 
+/* Xylon FB core layer buffers functions */
+extern u32 xylonfb_get_buffer_lines(struct xylonfb_layer_fix_data *fd,
+				    u32 yres);
+extern u32 xylonfb_get_max_buffers(struct fb_info *fbi);
+extern void xylonfb_set_buffers(struct fb_info *fbi, u32 buffers);
+
+#if defined(CONFIG_DEBUG_FS)
+/* Xylon FB debugfs functions */
+extern void xylonfb_debugfs_init(struct xylonfb_data *data);
+extern void xylonfb_debugfs_deinit(struct xylonfb_data *data);
+#endif
+
 /* Xylon FB core interface functions */
 extern int xylonfb_init_core(struct xylonfb_data *data);
 extern int xylonfb_deinit_core(struct platform_device *pdev);
@@ -0,0 +1,220 @@
+/*
+ * Xylon logiCVC frame buffer driver CVT timing generator
+ *
+ * Copyright (C) 2016 Xylon d.o.o.
+ * Author: Davor Joja <davor.joja@logicbricks.com>
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * VESA Coordinated Video Timings 1.2 for progressive video modes without
+ * margins, calculated in integer arithmetic with times in picoseconds.
+ * Supported are standard CRT blanking, reduced blanking version 1 and
+ * reduced blanking version 2.
+ */
+
+#include <linux/fb.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/string.h>
+
+#include "xylonfb_core.h"
+
+#define XYLONFB_CVT_CELL_GRAN		8
+#define XYLONFB_CVT_MIN_V_PORCH		3
+#define XYLONFB_CVT_MIN_V_BPORCH	6
+/* minimum V sync + back porch time for standard blanking */
+#define XYLONFB_CVT_MIN_VSYNC_BP	550000000ULL
+#define XYLONFB_CVT_CLOCK_STEP		250
+#define XYLONFB_CVT_H_SYNC_PERCENT	8
+
+/* minimum V blanking time for reduced blanking */
+#define XYLONFB_CVT_RB_MIN_VBLANK	460000000ULL
+#define XYLONFB_CVT_RB_H_BLANK		160
+#define XYLONFB_CVT_RB_H_SYNC		32
+#define XYLONFB_CVT_RB_V_FPORCH		3
+
+#define XYLONFB_CVT_RB2_H_BLANK		80
+#define XYLONFB_CVT_RB2_H_SYNC		32
+#define XYLONFB_CVT_RB2_H_BPORCH	40
+#define XYLONFB_CVT_RB2_V_FPORCH	1
+#define XYLONFB_CVT_RB2_V_SYNC		8
+#define XYLONFB_CVT_RB2_CLOCK_STEP	1
+
+/* V sync length encodes aspect ratio */
+static u32 xylonfb_cvt_vsync(u32 xres, u32 yres)
+{
+	if ((xres * 3) == (yres * 4))
+		return 4;
+	if ((xres * 9) == (yres * 16))
+		return 5;
+	if ((xres * 10) == (yres * 16))
+		return 6;
+	if (((xres * 4) == (yres * 5)) || ((xres * 9) == (yres * 15)))
+		return 7;
+
+	return 10;
+}
+
+/*
+ * Calculates CVT video mode of given resolution and refresh rate.
+ * rb is reduced blanking version, 0 for standard blanking.
+ */
+int xylonfb_cvt_mode(struct fb_videomode *vm, u32 xres, u32 yres,
+		     u32 refresh, u32 rb)
+{
+	u64 frame, hperiod, vblank_min;
+	u32 hdisp, hblank, hsync, hbp, vsync, vfp, vbp, vblank;
+	u32 duty, step, pixclk_khz;
+
+	XYLONFB_DBG(INFO, "%s %ux%u@%u rb %u", __func__,
+		    xres, yres, refresh, rb);
+
+	if (!xres || !yres || !refresh || (rb > XYLONFB_CVT_RB_V2))
+		return -EINVAL;
+
+	frame = div_u64(1000000000000ULL, refresh);
+	vblank_min = rb ? XYLONFB_CVT_RB_MIN_VBLANK : XYLONFB_CVT_MIN_VSYNC_BP;
+	if (frame <= vblank_min)
+		return -EINVAL;
+
+	if (rb == XYLONFB_CVT_RB_V2)
+		hdisp = xres;
+	else
+		hdisp = rounddown(xres, XYLONFB_CVT_CELL_GRAN);
+
+	if (rb == XYLONFB_CVT_RB_NONE) {
+		vsync = xylonfb_cvt_vsync(hdisp, yres);
+		vfp = XYLONFB_CVT_MIN_V_PORCH;
+		hperiod = div_u64(frame - vblank_min, yres + vfp);
+
+		/* V sync + back porch lines */
+		vblank = div64_u64(vblank_min, hperiod) + 1;
+		if (vblank < (vsync + XYLONFB_CVT_MIN_V_BPORCH))
+			vblank = vsync + XYLONFB_CVT_MIN_V_BPORCH;
+		vbp = vblank - vsync;
+		vblank += vfp;
+
+		/* H blanking duty cycle in 1/1000 %, at least 20 % */
+		duty = div_u64(hperiod * 3, 10000);
+		duty = (duty < 10000) ? (30000 - duty) : 20000;
+		hblank = (hdisp * duty) / (100000 - duty);
+		hblank = rounddown(hblank, 2 * XYLONFB_CVT_CELL_GRAN);
+		hsync = ((hdisp + hblank) * XYLONFB_CVT_H_SYNC_PERCENT) / 100;
+		hsync = rounddown(hsync, XYLONFB_CVT_CELL_GRAN);
+		hbp = hblank / 2;
+
+		pixclk_khz = div64_u64((u64)(hdisp + hblank) * 1000000000,
+				       hperiod);
+		step = XYLONFB_CVT_CLOCK_STEP;
+	} else {
+		if (rb == XYLONFB_CVT_RB_V1) {
+			vsync = xylonfb_cvt_vsync(hdisp, yres);
+			vfp = XYLONFB_CVT_RB_V_FPORCH;
+			hblank = XYLONFB_CVT_RB_H_BLANK;
+			hsync = XYLONFB_CVT_RB_H_SYNC;
+			hbp = hblank / 2;
+			step = XYLONFB_CVT_CLOCK_STEP;
+		} else {
+			vsync = XYLONFB_CVT_RB2_V_SYNC;
+			vfp = XYLONFB_CVT_RB2_V_FPORCH;
+			hblank = XYLONFB_CVT_RB2_H_BLANK;
+			hsync = XYLONFB_CVT_RB2_H_SYNC;
+			hbp = XYLONFB_CVT_RB2_H_BPORCH;
+			step = XYLONFB_CVT_RB2_CLOCK_STEP;
+		}
+		hperiod = div_u64(frame - vblank_min, yres);
+
+		vblank = div64_u64(vblank_min, hperiod) + 1;
+		if (vblank < (vfp + vsync + XYLONFB_CVT_MIN_V_BPORCH))
+			vblank = vfp + vsync + XYLONFB_CVT_MIN_V_BPORCH;
+		/* version 1 extends back porch, version 2 front porch */
+		if (rb == XYLONFB_CVT_RB_V1) {
+			vbp = vblank - vfp - vsync;
+		} else {
+			vbp = XYLONFB_CVT_MIN_V_BPORCH;
+			vfp = vblank - vsync - vbp;
+		}
+
+		pixclk_khz = div_u64((u64)refresh * (hdisp + hblank) *
+				     (yres + vblank), 1000);
+	}
+	pixclk_khz = rounddown(pixclk_khz, step);
+	if (!pixclk_khz)
+		return -EINVAL;
+
+	memset(vm, 0, sizeof(*vm));
+	vm->refresh = refresh;
+	vm->xres = xres;
+	vm->yres = yres;
+	vm->pixclock = KHZ2PICOS(pixclk_khz);
+	vm->left_margin = hbp;
+	/* rounded off active pixels are taken from front porch */
+	vm->right_margin = hdisp + hblank - xres - hsync - hbp;
+	vm->hsync_len = hsync;
+	vm->upper_margin = vbp;
+	vm->lower_margin = vfp;
+	vm->vsync_len = vsync;
+	vm->sync = rb ? FB_SYNC_HOR_HIGH_ACT : FB_SYNC_VERT_HIGH_ACT;
+	vm->vmode = FB_VMODE_NONINTERLACED;
+
+	return 0;
+}
+
+/*
+ * Sets var to CVT timings of mode option "<xres>x<yres>[M][R][-<bpp>]
+ * [@<refresh>]". CVT is used if requested with 'M' or 'R', or if
+ * resolution has no exact match in mode database. Without 'M', reduced
+ * blanking version set in device tree is preferred.
+ * Interlaced and margins modes are left to fb_find_mode().
+ */
+int xylonfb_cvt_var(struct xylonfb_data *data, const char *option,
+		    bool exact, struct fb_var_screeninfo *var)
+{
+	struct fb_videomode vm;
+	const char *c;
+	char *s;
+	u32 xres, yres, refresh, rb;
+	int ret;
+
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	if (!option)
+		return -EINVAL;
+
+	xres = simple_strtoul(option, &s, 10);
+	if (*s != 'x')
+		return -EINVAL;
+	yres = simple_strtoul(s + 1, &s, 10);
+
+	if (strchr(s, 'i') || strchr(s, 'm'))
+		return -EINVAL;
+	if (exact && !strchr(s, 'M') && !strchr(s, 'R'))
+		return -EINVAL;
+
+	if (strchr(s, 'R'))
+		rb = data->cvt_rb ? data->cvt_rb : XYLONFB_CVT_RB_V1;
+	else if (strchr(s, 'M'))
+		rb = XYLONFB_CVT_RB_NONE;
+	else
+		rb = data->cvt_rb;
+
+	c = strchr(s, '@');
+	refresh = c ? simple_strtoul(c + 1, NULL, 10) : 60;
+
+	ret = xylonfb_cvt_mode(&vm, xres, yres, refresh, rb);
+	if (ret)
+		return ret;
+
+	fb_videomode_to_var(var, &vm);
+
+	return 0;
+}
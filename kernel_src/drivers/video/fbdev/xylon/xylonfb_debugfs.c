@@ -0,0 +1,328 @@
+/*
+ * Xylon logiCVC frame buffer driver debugfs interface
+ *
+ * Copyright (C) 2016 Xylon d.o.o.
+ * Author: Davor Joja <davor.joja@logicbricks.com>
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/console.h>
+#include <linux/debugfs.h>
+#include <linux/fb.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/platform_device.h>
+#include <linux/seq_file.h>
+
+#include "xylonfb_core.h"
+#include "logicvc.h"
+
+static int xylonfb_debugfs_vmem_layout_show(struct seq_file *s, void *unused)
+{
+	struct xylonfb_data *data = s->private;
+	struct fb_info **afbi = dev_get_drvdata(&data->pdev->dev);
+	struct fb_info *fbi;
+	struct xylonfb_layer_data *ld;
+	struct xylonfb_layer_fix_data *fd;
+	u32 burst = data->burst_size;
+	u32 line_length, buffer_length, stride_padding;
+	int i;
+
+	seq_printf(s, "burst size: %u bytes\n", burst);
+
+	for (i = 0; i < data->layers; i++) {
+		fbi = afbi[i];
+		ld = fbi->par;
+		fd = ld->fd;
+
+		line_length = fd->width * (fd->bpp / 8);
+		stride_padding = (fd->width - fbi->var.xres) * (fd->bpp / 8);
+		if (fd->buffer_offset)
+			buffer_length = fd->buffer_offset * line_length;
+		else
+			buffer_length = fbi->var.yres * line_length;
+
+		seq_printf(s, "layer %u: fb%d\n", fd->id, fbi->node);
+		seq_printf(s, "  memory: 0x%08llx - 0x%08llx (%u bytes)%s\n",
+			   (unsigned long long)ld->fb_pbase,
+			   (unsigned long long)(ld->fb_pbase + ld->fb_size),
+			   ld->fb_size,
+			   (ld->fb_pbase & (burst - 1)) ? " misaligned" : "");
+		seq_printf(s, "  line: %u bytes, burst padding %u bytes\n",
+			   line_length, fd->line_padding);
+		seq_printf(s, "  stride padding: %u bytes per line\n",
+			   stride_padding);
+		seq_printf(s, "  height: %u lines\n", fd->height);
+		seq_printf(s, "  buffers: %u x %u bytes%s\n",
+			   ld->buffers, buffer_length,
+			   (buffer_length & (burst - 1)) ? " misaligned" : "");
+	}
+
+	return 0;
+}
+
+static int xylonfb_debugfs_vmem_layout_open(struct inode *inode,
+					    struct file *file)
+{
+	return single_open(file, xylonfb_debugfs_vmem_layout_show,
+			   inode->i_private);
+}
+
+static const struct file_operations xylonfb_debugfs_vmem_layout_fops = {
+	.owner = THIS_MODULE,
+	.open = xylonfb_debugfs_vmem_layout_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int xylonfb_debugfs_bandwidth_show(struct seq_file *s, void *unused)
+{
+	struct xylonfb_data *data = s->private;
+	struct fb_info **afbi = dev_get_drvdata(&data->pdev->dev);
+	struct fb_var_screeninfo *var = &afbi[0]->var;
+	struct xylonfb_layer_data *ld;
+	u64 rate, total = 0;
+	u32 width;
+	int i;
+
+	for (i = 0; i < data->layers; i++) {
+		ld = afbi[i]->par;
+		width = xylonfb_bw_layer_width(ld, var->xres);
+		rate = xylonfb_bw_layer(ld, var, width);
+		if (ld->flags & XYLONFB_FLAGS_LAYER_ENABLED)
+			total += rate;
+
+		seq_printf(s, "layer %u: %llu MB/s%s\n", ld->fd->id,
+			   div_u64(rate, 1000000),
+			   (ld->flags & XYLONFB_FLAGS_LAYER_ENABLED) ?
+			   "" : " disabled");
+	}
+
+	seq_printf(s, "total: %llu MB/s\n", div_u64(total, 1000000));
+	if (data->mem_bw)
+		seq_printf(s, "budget: %u MB/s, utilisation %llu%%\n",
+			   data->mem_bw,
+			   div_u64(total, (u64)data->mem_bw * 10000));
+	else
+		seq_puts(s, "budget: not set\n");
+	seq_printf(s, "FIFO underruns: %d\n",
+		   atomic_read(&data->underruns));
+
+	return 0;
+}
+
+static int xylonfb_debugfs_bandwidth_open(struct inode *inode,
+					  struct file *file)
+{
+	return single_open(file, xylonfb_debugfs_bandwidth_show,
+			   inode->i_private);
+}
+
+static const struct file_operations xylonfb_debugfs_bandwidth_fops = {
+	.owner = THIS_MODULE,
+	.open = xylonfb_debugfs_bandwidth_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int xylonfb_debugfs_vmode_show(struct seq_file *s, void *unused)
+{
+	struct xylonfb_data *data = s->private;
+	struct xylonfb_vmode *vm = &data->vm_active;
+	struct fb_videomode *v = &vm->vmode;
+
+	mutex_lock(&data->vmode_mutex);
+
+	seq_printf(s, "video mode: %s\n", vm->name);
+	seq_printf(s, "resolution: %ux%u%s\n", v->xres, v->yres,
+		   (v->vmode & FB_VMODE_INTERLACED) ? " interlaced" : "");
+	seq_printf(s, "pixel clock: %lu kHz\n", vm->pixclk_khz);
+	seq_printf(s, "refresh: %u.%03u Hz\n", vm->refresh_mhz / 1000,
+		   vm->refresh_mhz % 1000);
+	seq_printf(s, "horizontal: %u %u %u %u\n", v->xres, v->right_margin,
+		   v->hsync_len, v->left_margin);
+	seq_printf(s, "vertical: %u %u %u %u\n", v->yres, v->lower_margin,
+		   v->vsync_len, v->upper_margin);
+
+	mutex_unlock(&data->vmode_mutex);
+
+	return 0;
+}
+
+static int xylonfb_debugfs_vmode_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, xylonfb_debugfs_vmode_show,
+			   inode->i_private);
+}
+
+static const struct file_operations xylonfb_debugfs_vmode_fops = {
+	.owner = THIS_MODULE,
+	.open = xylonfb_debugfs_vmode_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+#define XYLONFB_ACCEL_BENCH_LOOPS	16
+#define XYLONFB_ACCEL_BENCH_LINES	16
+
+struct xylonfb_accel_bench {
+	const char *name;
+	void (*fillrect)(struct fb_info *fbi, const struct fb_fillrect *rect);
+	void (*copyarea)(struct fb_info *fbi, const struct fb_copyarea *area);
+	void (*imageblit)(struct fb_info *fbi, const struct fb_image *image);
+};
+
+static const struct xylonfb_accel_bench xylonfb_accel_bench[] = {
+	{ "xylonfb", xylonfb_fillrect, xylonfb_copyarea, xylonfb_imageblit },
+	{ "cfb", cfb_fillrect, cfb_copyarea, cfb_imageblit },
+};
+
+/* 8x16 glyph with mixed foreground and background pixels in each line */
+static const u8 xylonfb_accel_bench_glyph[XYLONFB_ACCEL_BENCH_LINES] = {
+	0x00, 0x00, 0x7C, 0xC6, 0xC6, 0xCE, 0xDE, 0xF6,
+	0xE6, 0xC6, 0xC6, 0x7C, 0x00, 0x00, 0x00, 0x00
+};
+
+static int xylonfb_debugfs_accel_bench_show(struct seq_file *s, void *unused)
+{
+	struct xylonfb_data *data = s->private;
+	struct fb_info **afbi = dev_get_drvdata(&data->pdev->dev);
+	struct fb_info *fbi;
+	const struct xylonfb_accel_bench *b;
+	struct fb_fillrect rect;
+	struct fb_copyarea area;
+	struct fb_image image;
+	ktime_t start;
+	s64 fill_us, scroll_us, glyph_us;
+	u32 xres, yres, glyphs;
+	int i, j;
+
+	fbi = afbi[(data->console_layer < data->layers) ?
+		   data->console_layer : 0];
+	xres = fbi->var.xres;
+	yres = fbi->var.yres;
+	if (yres <= XYLONFB_ACCEL_BENCH_LINES || xres < 8)
+		return -EINVAL;
+	glyphs = (xres / 8) * (yres / XYLONFB_ACCEL_BENCH_LINES);
+
+	memset(&rect, 0, sizeof(rect));
+	rect.width = xres;
+	rect.height = yres;
+	rect.rop = ROP_COPY;
+
+	/* fbcon scroll by one text line */
+	memset(&area, 0, sizeof(area));
+	area.sy = XYLONFB_ACCEL_BENCH_LINES;
+	area.width = xres;
+	area.height = yres - XYLONFB_ACCEL_BENCH_LINES;
+
+	memset(&image, 0, sizeof(image));
+	image.width = 8;
+	image.height = XYLONFB_ACCEL_BENCH_LINES;
+	image.fg_color = 7;
+	image.depth = 1;
+	image.data = (const char *)xylonfb_accel_bench_glyph;
+
+	seq_printf(s, "fb%d: %ux%u-%u, %d loops, time in us per loop\n",
+		   fbi->node, xres, yres, fbi->var.bits_per_pixel,
+		   XYLONFB_ACCEL_BENCH_LOOPS);
+	seq_printf(s, "drawing DMA: %s\n", data->blit_chan ? "yes" : "no");
+	seq_printf(s, "%-8s %10s %10s %10s\n", "", "fill", "scroll",
+		   "glyphs");
+
+	console_lock();
+	for (i = 0; i < ARRAY_SIZE(xylonfb_accel_bench); i++) {
+		b = &xylonfb_accel_bench[i];
+
+		start = ktime_get();
+		for (j = 0; j < XYLONFB_ACCEL_BENCH_LOOPS; j++)
+			b->fillrect(fbi, &rect);
+		xylonfb_accel_sync(data, true);
+		fill_us = ktime_us_delta(ktime_get(), start);
+
+		start = ktime_get();
+		for (j = 0; j < XYLONFB_ACCEL_BENCH_LOOPS; j++)
+			b->copyarea(fbi, &area);
+		xylonfb_accel_sync(data, true);
+		scroll_us = ktime_us_delta(ktime_get(), start);
+
+		start = ktime_get();
+		for (j = 0; j < (XYLONFB_ACCEL_BENCH_LOOPS * glyphs); j++) {
+			image.dx = ((j % glyphs) % (xres / 8)) * 8;
+			image.dy = ((j % glyphs) / (xres / 8)) *
+				   XYLONFB_ACCEL_BENCH_LINES;
+			b->imageblit(fbi, &image);
+		}
+		xylonfb_accel_sync(data, true);
+		glyph_us = ktime_us_delta(ktime_get(), start);
+
+		seq_printf(s, "%-8s %10lld %10lld %10lld\n", b->name,
+			   fill_us / XYLONFB_ACCEL_BENCH_LOOPS,
+			   scroll_us / XYLONFB_ACCEL_BENCH_LOOPS,
+			   glyph_us / XYLONFB_ACCEL_BENCH_LOOPS);
+	}
+	console_unlock();
+
+	return 0;
+}
+
+static int xylonfb_debugfs_accel_bench_open(struct inode *inode,
+					    struct file *file)
+{
+	return single_open(file, xylonfb_debugfs_accel_bench_show,
+			   inode->i_private);
+}
+
+static const struct file_operations xylonfb_debugfs_accel_bench_fops = {
+	.owner = THIS_MODULE,
+	.open = xylonfb_debugfs_accel_bench_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void xylonfb_debugfs_init(struct xylonfb_data *data)
+{
+	struct device *dev = &data->pdev->dev;
+	char name[32];
+
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	snprintf(name, sizeof(name), "%s-%s", XYLONFB_DRIVER_NAME,
+		 dev_name(dev));
+
+	data->debugfs = debugfs_create_dir(name, NULL);
+	if (IS_ERR_OR_NULL(data->debugfs)) {
+		dev_warn(dev, "failed create debugfs\n");
+		data->debugfs = NULL;
+		return;
+	}
+
+	debugfs_create_file("vmem_layout", S_IRUGO, data->debugfs, data,
+			    &xylonfb_debugfs_vmem_layout_fops);
+	debugfs_create_file("bandwidth", S_IRUGO, data->debugfs, data,
+			    &xylonfb_debugfs_bandwidth_fops);
+	debugfs_create_file("vmode", S_IRUGO, data->debugfs, data,
+			    &xylonfb_debugfs_vmode_fops);
+	debugfs_create_file("accel_bench", S_IRUSR, data->debugfs, data,
+			    &xylonfb_debugfs_accel_bench_fops);
+}
+
+void xylonfb_debugfs_deinit(struct xylonfb_data *data)
+{
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	debugfs_remove_recursive(data->debugfs);
+	data->debugfs = NULL;
+}
@@ -0,0 +1,617 @@
+/*
+ * Xylon logiCVC frame buffer driver pixel formats
+ *
+ * Copyright (C) 2016 Xylon d.o.o.
+ * Author: Davor Joja <davor.joja@logicbricks.com>
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/videodev2.h>
+#include <uapi/linux/xylonfb.h>
+
+#include "xylonfb_core.h"
+#include "logicvc.h"
+
+#define LOGICVC_PIX_FMT_AYUV			v4l2_fourcc('A', 'Y', 'U', 'V')
+#define LOGICVC_PIX_FMT_AVUY			v4l2_fourcc('A', 'V', 'U', 'Y')
+#define LOGICVC_PIX_FMT_ALPHA			v4l2_fourcc('A', '8', ' ', ' ')
+/* Framebuffer v4 added YUV formats */
+#define LOGICVC_PIX_FMT_XYUV			v4l2_fourcc('X', 'Y', 'U', 'V')
+#define LOGICVC_PIX_FMT_XVUY			v4l2_fourcc('X', 'V', 'U', 'Y')
+#define LOGICVC_PIX_FMT_YUYV_121010		v4l2_fourcc('Y', 'U', '2', '0')
+#define LOGICVC_PIX_FMT_UYVY_121010		v4l2_fourcc('U', 'Y', '2', '0')
+#define LOGICVC_PIX_FMT_XYUV_2101010	v4l2_fourcc('X', 'Y', '3', '0')
+#define LOGICVC_PIX_FMT_XVUY_2101010	v4l2_fourcc('X', 'V', '3', '0')
+
+#define XYLONFB_PACK(c, bf) \
+	((((c) & 0xFF) >> (8 - (bf).length)) << (bf).offset)
+
+/* CLUT entry or 32 bpp pixel, components up to 8 bits */
+static u32 xylonfb_pack_rgb32(struct fb_info *fbi, u16 t, u16 r, u16 g, u16 b)
+{
+	struct fb_var_screeninfo *var = &fbi->var;
+	u32 pixel;
+
+	pixel = XYLONFB_PACK(r, var->red) | XYLONFB_PACK(g, var->green) |
+		XYLONFB_PACK(b, var->blue);
+	if (var->transp.length)
+		pixel |= XYLONFB_PACK(t, var->transp);
+
+	return pixel;
+}
+
+static u32 xylonfb_pack_rgb16(struct fb_info *fbi, u16 t, u16 r, u16 g, u16 b)
+{
+	u32 pixel = xylonfb_pack_rgb32(fbi, t, r, g, b);
+
+	return (pixel << 16) | pixel;
+}
+
+static u32 xylonfb_pack_rgb8(struct fb_info *fbi, u16 t, u16 r, u16 g, u16 b)
+{
+	u32 pixel = xylonfb_pack_rgb32(fbi, t, r, g, b);
+
+	return (pixel << 24) | (pixel << 16) | (pixel << 8) | pixel;
+}
+
+static u32 xylonfb_pack_rgb10(struct fb_info *fbi, u16 t, u16 r, u16 g, u16 b)
+{
+	struct fb_var_screeninfo *var = &fbi->var;
+
+	return ((r & 0x3FF) << var->red.offset) |
+	       ((g & 0x3FF) << var->green.offset) |
+	       ((b & 0x3FF) << var->blue.offset);
+}
+
+static u32 xylonfb_pack_ayuv(struct fb_info *fbi, u16 t, u16 r, u16 g, u16 b)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+
+	return ((t & 0xFF) << 24) | xylonfb_rgb2yuv(ld->data, r, g, b);
+}
+
+static const struct xylonfb_format xylonfb_formats[] = {
+	[XYLONFB_FORMAT_A8] = {
+		.bpp = 8,
+		.type = FB_TYPE_PACKED_PIXELS,
+		.visual = FB_VISUAL_FOURCC,
+		.fourcc = LOGICVC_PIX_FMT_ALPHA,
+		.transp = { 0, 8, 0 },
+		.console = true,
+	},
+	[XYLONFB_FORMAT_C8] = {
+		.bpp = 8,
+		.type = FB_TYPE_PACKED_PIXELS,
+		.visual = FB_VISUAL_PSEUDOCOLOR,
+		.console = true,
+	},
+	[XYLONFB_FORMAT_CLUT_ARGB6565] = {
+		.bpp = 32,
+		.type = FB_TYPE_PACKED_PIXELS,
+		.visual = FB_VISUAL_PSEUDOCOLOR,
+		.transp = { 24, 6, 0 },
+		.red = { 19, 5, 0 },
+		.green = { 10, 6, 0 },
+		.blue = { 3, 5, 0 },
+		.pack = xylonfb_pack_rgb32,
+	},
+	[XYLONFB_FORMAT_CLUT_ARGB8888] = {
+		.bpp = 32,
+		.type = FB_TYPE_PACKED_PIXELS,
+		.visual = FB_VISUAL_PSEUDOCOLOR,
+		.transp = { 24, 8, 0 },
+		.red = { 16, 8, 0 },
+		.green = { 8, 8, 0 },
+		.blue = { 0, 8, 0 },
+		.pack = xylonfb_pack_rgb32,
+	},
+	[XYLONFB_FORMAT_CLUT_AYUV8888] = {
+		.bpp = 32,
+		.type = FB_TYPE_PACKED_PIXELS,
+		.visual = FB_VISUAL_PSEUDOCOLOR,
+		.fourcc = LOGICVC_PIX_FMT_AYUV,
+		.transp = { 24, 8, 0 },
+		.red = { 16, 8, 0 },
+		.green = { 8, 8, 0 },
+		.blue = { 0, 8, 0 },
+		.pack = xylonfb_pack_ayuv,
+	},
+	[XYLONFB_FORMAT_RGB332] = {
+		.bpp = 8,
+		.type = FB_TYPE_PACKED_PIXELS,
+		.visual = FB_VISUAL_TRUECOLOR,
+		.red = { 5, 3, 0 },
+		.green = { 2, 3, 0 },
+		.blue = { 0, 2, 0 },
+		.pack = xylonfb_pack_rgb8,
+		.console = true,
+	},
+	[XYLONFB_FORMAT_BGR233] = {
+		.bpp = 8,
+		.type = FB_TYPE_PACKED_PIXELS,
+		.visual = FB_VISUAL_TRUECOLOR,
+		.red = { 0, 3, 0 },
+		.green = { 3, 3, 0 },
+		.blue = { 6, 2, 0 },
+		.pack = xylonfb_pack_rgb8,
+		.console = true,
+	},
+	[XYLONFB_FORMAT_ARGB3332] = {
+		.bpp = 16,
+		.type = FB_TYPE_PACKED_PIXELS,
+		.visual = FB_VISUAL_TRUECOLOR,
+		.transp = { 8, 3, 0 },
+		.red = { 5, 3, 0 },
+		.green = { 2, 3, 0 },
+		.blue = { 0, 2, 0 },
+		.pack = xylonfb_pack_rgb16,
+		.console = true,
+	},
+	[XYLONFB_FORMAT_ABGR3233] = {
+		.bpp = 16,
+		.type = FB_TYPE_PACKED_PIXELS,
+		.visual = FB_VISUAL_TRUECOLOR,
+		.transp = { 8, 3, 0 },
+		.red = { 0, 3, 0 },
+		.green = { 3, 3, 0 },
+		.blue = { 6, 2, 0 },
+		.pack = xylonfb_pack_rgb16,
+		.console = true,
+	},
+	[XYLONFB_FORMAT_RGB565] = {
+		.bpp = 16,
+		.type = FB_TYPE_PACKED_PIXELS,
+		.visual = FB_VISUAL_TRUECOLOR,
+		.red = { 11, 5, 0 },
+		.green = { 5, 6, 0 },
+		.blue = { 0, 5, 0 },
+		.pack = xylonfb_pack_rgb16,
+		.console = true,
+	},
+	[XYLONFB_FORMAT_BGR565] = {
+		.bpp = 16,
+		.type = FB_TYPE_PACKED_PIXELS,
+		.visual = FB_VISUAL_TRUECOLOR,
+		.red = { 0, 5, 0 },
+		.green = { 5, 6, 0 },
+		.blue = { 11, 5, 0 },
+		.pack = xylonfb_pack_rgb16,
+		.console = true,
+	},
+	[XYLONFB_FORMAT_ARGB565] = {
+		.bpp = 32,
+		.type = FB_TYPE_PACKED_PIXELS,
+		.visual = FB_VISUAL_TRUECOLOR,
+		.transp = { 24, 6, 0 },
+		.red = { 11, 5, 0 },
+		.green = { 5, 6, 0 },
+		.blue = { 0, 5, 0 },
+		.pack = xylonfb_pack_rgb32,
+		.console = true,
+	},
+	[XYLONFB_FORMAT_ABGR565] = {
+		.bpp = 32,
+		.type = FB_TYPE_PACKED_PIXELS,
+		.visual = FB_VISUAL_TRUECOLOR,
+		.transp = { 24, 6, 0 },
+		.red = { 0, 5, 0 },
+		.green = { 5, 6, 0 },
+		.blue = { 11, 5, 0 },
+		.pack = xylonfb_pack_rgb32,
+		.console = true,
+	},
+	[XYLONFB_FORMAT_XRGB8888] = {
+		.bpp = 32,
+		.type = FB_TYPE_PACKED_PIXELS,
+		.visual = FB_VISUAL_TRUECOLOR,
+		.red = { 16, 8, 0 },
+		.green = { 8, 8, 0 },
+		.blue = { 0, 8, 0 },
+		.pack = xylonfb_pack_rgb32,
+		.console = true,
+	},
+	[XYLONFB_FORMAT_XBGR8888] = {
+		.bpp = 32,
+		.type = FB_TYPE_PACKED_PIXELS,
+		.visual = FB_VISUAL_TRUECOLOR,
+		.red = { 0, 8, 0 },
+		.green = { 8, 8, 0 },
+		.blue = { 16, 8, 0 },
+		.pack = xylonfb_pack_rgb32,
+		.console = true,
+	},
+	[XYLONFB_FORMAT_ARGB8888] = {
+		.bpp = 32,
+		.type = FB_TYPE_PACKED_PIXELS,
+		.visual = FB_VISUAL_TRUECOLOR,
+		.transp = { 24, 8, 0 },
+		.red = { 16, 8, 0 },
+		.green = { 8, 8, 0 },
+		.blue = { 0, 8, 0 },
+		.pack = xylonfb_pack_rgb32,
+		.console = true,
+	},
+	[XYLONFB_FORMAT_ABGR8888] = {
+		.bpp = 32,
+		.type = FB_TYPE_PACKED_PIXELS,
+		.visual = FB_VISUAL_TRUECOLOR,
+		.transp = { 24, 8, 0 },
+		.red = { 0, 8, 0 },
+		.green = { 8, 8, 0 },
+		.blue = { 16, 8, 0 },
+		.pack = xylonfb_pack_rgb32,
+		.console = true,
+	},
+	[XYLONFB_FORMAT_XRGB2101010] = {
+		.bpp = 32,
+		.type = FB_TYPE_PACKED_PIXELS,
+		.visual = FB_VISUAL_TRUECOLOR,
+		.red = { 20, 10, 0 },
+		.green = { 10, 10, 0 },
+		.blue = { 0, 10, 0 },
+		.pack = xylonfb_pack_rgb10,
+		.console = true,
+	},
+	[XYLONFB_FORMAT_XBGR2101010] = {
+		.bpp = 32,
+		.type = FB_TYPE_PACKED_PIXELS,
+		.visual = FB_VISUAL_TRUECOLOR,
+		.red = { 0, 10, 0 },
+		.green = { 10, 10, 0 },
+		.blue = { 20, 10, 0 },
+		.pack = xylonfb_pack_rgb10,
+		.console = true,
+	},
+	[XYLONFB_FORMAT_YUYV] = {
+		.bpp = 16,
+		.type = FB_TYPE_FOURCC,
+		.visual = FB_VISUAL_FOURCC,
+		.fourcc = V4L2_PIX_FMT_VYUY,
+		.transp = { 16, 8, 0 },
+		.red = { 0, 8, 0 },
+		.green = { 8, 8, 0 },
+		.blue = { 24, 8, 0 },
+		.console = true,
+		.yuv422 = true,
+	},
+	[XYLONFB_FORMAT_UYVY] = {
+		.bpp = 16,
+		.type = FB_TYPE_FOURCC,
+		.visual = FB_VISUAL_FOURCC,
+		.fourcc = V4L2_PIX_FMT_VYUY,
+		.transp = { 24, 8, 0 },
+		.red = { 8, 8, 0 },
+		.green = { 0, 8, 0 },
+		.blue = { 16, 8, 0 },
+		.console = true,
+		.yuv422 = true,
+	},
+	[XYLONFB_FORMAT_YUYV_121010] = {
+		.bpp = 32,
+		.type = FB_TYPE_FOURCC,
+		.visual = FB_VISUAL_FOURCC,
+		.fourcc = LOGICVC_PIX_FMT_YUYV_121010,
+		.transp = { 0, 10, 0 },
+		.red = { 0, 10, 0 },
+		.green = { 10, 10, 0 },
+		.blue = { 10, 10, 0 },
+		.console = true,
+		.yuv422 = true,
+	},
+	[XYLONFB_FORMAT_UYVY_121010] = {
+		.bpp = 32,
+		.type = FB_TYPE_FOURCC,
+		.visual = FB_VISUAL_FOURCC,
+		.fourcc = LOGICVC_PIX_FMT_UYVY_121010,
+		.transp = { 10, 10, 0 },
+		.red = { 10, 10, 0 },
+		.green = { 0, 10, 0 },
+		.blue = { 0, 10, 0 },
+		.console = true,
+		.yuv422 = true,
+	},
+	[XYLONFB_FORMAT_AYUV] = {
+		.bpp = 32,
+		.type = FB_TYPE_FOURCC,
+		.visual = FB_VISUAL_FOURCC,
+		.fourcc = LOGICVC_PIX_FMT_AYUV,
+		.transp = { 24, 8, 0 },
+		.red = { 16, 8, 0 },
+		.green = { 8, 8, 0 },
+		.blue = { 0, 8, 0 },
+		.console = true,
+	},
+	[XYLONFB_FORMAT_AVUY] = {
+		.bpp = 32,
+		.type = FB_TYPE_FOURCC,
+		.visual = FB_VISUAL_FOURCC,
+		.fourcc = LOGICVC_PIX_FMT_AVUY,
+		.transp = { 24, 8, 0 },
+		.red = { 0, 8, 0 },
+		.green = { 8, 8, 0 },
+		.blue = { 16, 8, 0 },
+		.console = true,
+	},
+	[XYLONFB_FORMAT_XYUV] = {
+		.bpp = 32,
+		.type = FB_TYPE_FOURCC,
+		.visual = FB_VISUAL_FOURCC,
+		.fourcc = LOGICVC_PIX_FMT_XYUV,
+		.red = { 16, 8, 0 },
+		.green = { 8, 8, 0 },
+		.blue = { 0, 8, 0 },
+		.console = true,
+	},
+	[XYLONFB_FORMAT_XVUY] = {
+		.bpp = 32,
+		.type = FB_TYPE_FOURCC,
+		.visual = FB_VISUAL_FOURCC,
+		.fourcc = LOGICVC_PIX_FMT_XVUY,
+		.red = { 0, 8, 0 },
+		.green = { 8, 8, 0 },
+		.blue = { 16, 8, 0 },
+		.console = true,
+	},
+	[XYLONFB_FORMAT_XYUV_2101010] = {
+		.bpp = 32,
+		.type = FB_TYPE_FOURCC,
+		.visual = FB_VISUAL_FOURCC,
+		.fourcc = LOGICVC_PIX_FMT_XYUV_2101010,
+		.red = { 20, 10, 0 },
+		.green = { 10, 10, 0 },
+		.blue = { 0, 10, 0 },
+		.console = true,
+	},
+	[XYLONFB_FORMAT_XVUY_2101010] = {
+		.bpp = 32,
+		.type = FB_TYPE_FOURCC,
+		.visual = FB_VISUAL_FOURCC,
+		/* reported same as XYUV_2101010 for existing applications */
+		.fourcc = LOGICVC_PIX_FMT_XYUV_2101010,
+		.red = { 0, 10, 0 },
+		.green = { 10, 10, 0 },
+		.blue = { 20, 10, 0 },
+		.console = true,
+	},
+};
+
+static const struct xylonfb_rgb2yuv_coeff xylonfb_coeff_default = {
+	.cy = LOGICVC_COEFF_Y,
+	.cyr = LOGICVC_COEFF_Y_R,
+	.cyg = LOGICVC_COEFF_Y_G,
+	.cyb = LOGICVC_COEFF_Y_B,
+	.cu = LOGICVC_COEFF_U,
+	.cur = LOGICVC_COEFF_U_R,
+	.cug = LOGICVC_COEFF_U_G,
+	.cub = LOGICVC_COEFF_U_B,
+	.cv = LOGICVC_COEFF_V,
+	.cvr = LOGICVC_COEFF_V_R,
+	.cvg = LOGICVC_COEFF_V_G,
+	.cvb = LOGICVC_COEFF_V_B,
+};
+
+static const struct xylonfb_rgb2yuv_coeff xylonfb_coeff_itu656 = {
+	.cy = LOGICVC_COEFF_ITU656_Y,
+	.cyr = LOGICVC_COEFF_Y_R,
+	.cyg = LOGICVC_COEFF_Y_G,
+	.cyb = LOGICVC_COEFF_Y_B,
+	.cu = LOGICVC_COEFF_U,
+	.cur = LOGICVC_COEFF_ITU656_U_R,
+	.cug = LOGICVC_COEFF_ITU656_U_G,
+	.cub = LOGICVC_COEFF_ITU656_U_B,
+	.cv = LOGICVC_COEFF_V,
+	.cvr = LOGICVC_COEFF_ITU656_V_R,
+	.cvg = LOGICVC_COEFF_ITU656_V_G,
+	.cvb = LOGICVC_COEFF_ITU656_V_B,
+};
+
+/*
+ * ITU-R BT.601, BT.709 and BT.2020 coefficients scaled by LOGICVC_YUV_NORM.
+ * Limited range scales Y to 16 - 235 and U, V to 16 - 240.
+ * Offsets include 0.5 for rounding to nearest.
+ */
+static const struct xylonfb_rgb2yuv_coeff
+xylonfb_coeff[XYLONFB_COLOR_SPACE_BT2020][2] = {
+	[XYLONFB_COLOR_SPACE_BT601 - 1] = {
+		[XYLONFB_COLOR_RANGE_FULL] = {
+			.cy = 50000,
+			.cyr = 29900, .cyg = 58700, .cyb = 11400,
+			.cu = 12850000,
+			.cur = 16874, .cug = 33126, .cub = 50000,
+			.cv = 12850000,
+			.cvr = 50000, .cvg = 41869, .cvb = 8131,
+		},
+		[XYLONFB_COLOR_RANGE_LIMITED] = {
+			.cy = 1650000,
+			.cyr = 25679, .cyg = 50413, .cyb = 9791,
+			.cu = 12850000,
+			.cur = 14822, .cug = 29100, .cub = 43922,
+			.cv = 12850000,
+			.cvr = 43922, .cvg = 36779, .cvb = 7143,
+		},
+	},
+	[XYLONFB_COLOR_SPACE_BT709 - 1] = {
+		[XYLONFB_COLOR_RANGE_FULL] = {
+			.cy = 50000,
+			.cyr = 21260, .cyg = 71520, .cyb = 7220,
+			.cu = 12850000,
+			.cur = 11457, .cug = 38543, .cub = 50000,
+			.cv = 12850000,
+			.cvr = 50000, .cvg = 45415, .cvb = 4585,
+		},
+		[XYLONFB_COLOR_RANGE_LIMITED] = {
+			.cy = 1650000,
+			.cyr = 18259, .cyg = 61423, .cyb = 6201,
+			.cu = 12850000,
+			.cur = 10064, .cug = 33858, .cub = 43922,
+			.cv = 12850000,
+			.cvr = 43922, .cvg = 39895, .cvb = 4027,
+		},
+	},
+	[XYLONFB_COLOR_SPACE_BT2020 - 1] = {
+		[XYLONFB_COLOR_RANGE_FULL] = {
+			.cy = 50000,
+			.cyr = 26270, .cyg = 67800, .cyb = 5930,
+			.cu = 12850000,
+			.cur = 13963, .cug = 36037, .cub = 50000,
+			.cv = 12850000,
+			.cvr = 50000, .cvg = 45979, .cvb = 4021,
+		},
+		[XYLONFB_COLOR_RANGE_LIMITED] = {
+			.cy = 1650000,
+			.cyr = 22561, .cyg = 58229, .cyb = 5093,
+			.cu = 12850000,
+			.cur = 12266, .cug = 31656, .cub = 43922,
+			.cv = 12850000,
+			.cvr = 43922, .cvg = 40389, .cvb = 3533,
+		},
+	},
+};
+
+/*
+ * Division by LOGICVC_YUV_NORM is done as multiplication by its reciprocal
+ * scaled by 2^42, which gives exact quotient for dividends below 2^25.
+ */
+#define XYLONFB_YUV_NORM_RECIPROCAL	43980466ULL
+#define XYLONFB_YUV_NORM_SHIFT		42
+
+static u32 xylonfb_yuv_norm(s32 sum)
+{
+	u32 val;
+
+	if (sum < 0)
+		return 0;
+
+	val = ((u64)sum * XYLONFB_YUV_NORM_RECIPROCAL) >>
+	      XYLONFB_YUV_NORM_SHIFT;
+
+	return min_t(u32, val, 0xFF);
+}
+
+/*
+ * Builds RGB to YUV lookup tables from conversion coefficients.
+ * Red component tables include Y, U and V offsets.
+ */
+static void xylonfb_rgb2yuv_init(struct xylonfb_data *data)
+{
+	struct xylonfb_rgb2yuv_coeff *coeff = &data->coeff;
+	struct xylonfb_rgb2yuv_lut *lut = &data->yuv_lut;
+	s32 i;
+
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	for (i = 0; i < XYLONFB_YUV_LUT_SIZE; i++) {
+		lut->y[0][i] = (coeff->cyr * i) + coeff->cy;
+		lut->y[1][i] = coeff->cyg * i;
+		lut->y[2][i] = coeff->cyb * i;
+		lut->u[0][i] = -(coeff->cur * i) + coeff->cu;
+		lut->u[1][i] = -(coeff->cug * i);
+		lut->u[2][i] = coeff->cub * i;
+		lut->v[0][i] = (coeff->cvr * i) + coeff->cv;
+		lut->v[1][i] = -(coeff->cvg * i);
+		lut->v[2][i] = -(coeff->cvb * i);
+	}
+}
+
+/*
+ * Selects RGB to YUV conversion coefficients.
+ * Default color space uses logiCVC coefficients for the display interface.
+ */
+int xylonfb_set_color_space(struct xylonfb_data *data, u32 space, u32 range)
+{
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	if ((space > XYLONFB_COLOR_SPACE_BT2020) ||
+	    (range > XYLONFB_COLOR_RANGE_LIMITED))
+		return -EINVAL;
+
+	if (space != XYLONFB_COLOR_SPACE_DEFAULT)
+		data->coeff = xylonfb_coeff[space - 1][range];
+	else if (data->flags & XYLONFB_FLAGS_DISPLAY_INTERFACE_ITU656)
+		data->coeff = xylonfb_coeff_itu656;
+	else
+		data->coeff = xylonfb_coeff_default;
+
+	data->color_space = space;
+	data->color_range = range;
+
+	xylonfb_rgb2yuv_init(data);
+
+	return 0;
+}
+
+/* Converts 8 bit RGB components to XYUV8888 value */
+u32 xylonfb_rgb2yuv(struct xylonfb_data *data, u8 r, u8 g, u8 b)
+{
+	struct xylonfb_rgb2yuv_lut *lut = &data->yuv_lut;
+	u32 y, u, v;
+
+	y = xylonfb_yuv_norm(lut->y[0][r] + lut->y[1][g] + lut->y[2][b]);
+	u = xylonfb_yuv_norm(lut->u[0][r] + lut->u[1][g] + lut->u[2][b]);
+	v = xylonfb_yuv_norm(lut->v[0][r] + lut->v[1][g] + lut->v[2][b]);
+
+	return (y << 16) | (u << 8) | v;
+}
+
+static u32 xylonfb_yuv_norm_10(s32 sum)
+{
+	if (sum < 0)
+		return 0;
+
+	return min_t(u32, sum / LOGICVC_YUV_NORM, 0x3FF);
+}
+
+/*
+ * Offsets are 8 bit levels plus fraction for rounding. Levels are scaled
+ * to 10 bits, while rounding fraction is kept.
+ */
+static s32 xylonfb_yuv_offset_10(s32 offset)
+{
+	return (4 * offset) - (3 * (offset % LOGICVC_YUV_NORM));
+}
+
+/*
+ * Converts 10 bit RGB components to XYUV2101010 value.
+ * Sums of 10 bit components exceed lookup tables and exact range of the
+ * reciprocal, so they are divided.
+ */
+u32 xylonfb_rgb2yuv_10(struct xylonfb_data *data, u16 r, u16 g, u16 b)
+{
+	struct xylonfb_rgb2yuv_coeff *coeff = &data->coeff;
+	u32 y, u, v;
+
+	y = xylonfb_yuv_norm_10((coeff->cyr * r) + (coeff->cyg * g) +
+				(coeff->cyb * b) +
+				xylonfb_yuv_offset_10(coeff->cy));
+	u = xylonfb_yuv_norm_10(-(coeff->cur * r) - (coeff->cug * g) +
+				(coeff->cub * b) +
+				xylonfb_yuv_offset_10(coeff->cu));
+	v = xylonfb_yuv_norm_10((coeff->cvr * r) - (coeff->cvg * g) -
+				(coeff->cvb * b) +
+				xylonfb_yuv_offset_10(coeff->cv));
+
+	return (y << 20) | (u << 10) | v;
+}
+
+const struct xylonfb_format *xylonfb_get_format(u32 format)
+{
+	return &xylonfb_formats[format];
+}
+
+/* Format describing color components of layer pixel or CLUT entry */
+const struct xylonfb_format *
+xylonfb_get_color_format(struct xylonfb_layer_fix_data *fd)
+{
+	if (fd->format == XYLONFB_FORMAT_C8)
+		return &xylonfb_formats[fd->format_clut];
+
+	return &xylonfb_formats[fd->format];
+}
@@ -14,6 +14,7 @@
  * GNU General Public License for more details.
  */
 
+#include <linux/console.h>
 #include <linux/platform_device.h>
 #include <linux/uaccess.h>
 #include <uapi/linux/xylonfb.h>
@@ -34,13 +35,26 @@ static int xylonfb_get_vblank(struct fb_vblank *vblank, struct fb_info *fbi)
 	return 0;
 }
 
-static void xylonfb_vsync_ctrl(struct fb_info *fbi, bool enable)
+static void xylonfb_get_field(struct xylonfb_field *field, struct fb_info *fbi)
 {
 	struct xylonfb_layer_data *ld = fbi->par;
 	struct xylonfb_data *data = ld->data;
+
+	field->count = data->vsync.count;
+	field->field = data->vsync.field;
+	field->interlaced = !!(data->vm_active.vmode.vmode &
+			       FB_VMODE_INTERLACED);
+}
+
+void xylonfb_vsync_ctrl(struct fb_info *fbi, bool enable)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	struct xylonfb_data *data = ld->data;
+	unsigned long flags;
 	u32 imr;
 
 	mutex_lock(&data->irq_mutex);
+	spin_lock_irqsave(&data->irq_lock, flags);
 
 	imr = data->reg_access.get_reg_val(data->dev_base,
 					   LOGICVC_INT_MASK_ROFF, ld);
@@ -55,6 +69,7 @@ static void xylonfb_vsync_ctrl(struct fb_info *fbi, bool enable)
 	data->reg_access.set_reg_val(imr, data->dev_base,
 				     LOGICVC_INT_MASK_ROFF, ld);
 
+	spin_unlock_irqrestore(&data->irq_lock, flags);
 	mutex_unlock(&data->irq_mutex);
 }
 
@@ -108,48 +123,10 @@ static int xylonfb_layer_alpha(struct xylonfb_layer_data *ld, u16 *alpha,
 	if (fd->transparency != LOGICVC_ALPHA_LAYER)
 		return -EPERM;
 
-	switch (fd->type) {
-	case LOGICVC_LAYER_YUV:
-		switch (fd->format){
-		case XYLONFB_FORMAT_YUYV:
-		case XYLONFB_FORMAT_UYVY:
-		case XYLONFB_FORMAT_XYUV:
-		case XYLONFB_FORMAT_XVUY:
-			used_bits = 8;
-			break;
-		case XYLONFB_FORMAT_YUYV_121010:
-		case XYLONFB_FORMAT_UYVY_121010:
-		case XYLONFB_FORMAT_XYUV_2101010:
-		case XYLONFB_FORMAT_XVUY_2101010:
-			used_bits = 10;
-			break;
-		}
-		break;
-	case LOGICVC_LAYER_RGB:
-		switch (fd->format){
-		case XYLONFB_FORMAT_RGB332:
-		case XYLONFB_FORMAT_BGR233:
-			used_bits = 3;
-			break;
-		case XYLONFB_FORMAT_RGB565:
-		case XYLONFB_FORMAT_BGR565:
-			used_bits = 6;
-			break;
-		case XYLONFB_FORMAT_XRGB8888:
-		case XYLONFB_FORMAT_XBGR8888:
-			used_bits = 8;
-			break;
-		case XYLONFB_FORMAT_XRGB2101010:
-		case XYLONFB_FORMAT_XBGR2101010:
-			used_bits = 10;
-			break;
-		default:
-			return -EINVAL;
-		}
-		break;
-	default:
+	/* layer alpha resolution follows widest color component */
+	used_bits = xylonfb_get_format(fd->format)->green.length;
+	if (!used_bits)
 		return -EINVAL;
-	}
 
 	if (!set) {
 		val = data->reg_access.get_reg_val(ld->base,
@@ -178,7 +155,8 @@ static int xylonfb_layer_buff(struct fb_info *fbi,
 	u32 reg;
 
 	if (set) {
-		if (layer_buff->id >= LOGICVC_MAX_LAYER_BUFFERS)
+		if ((layer_buff->id >= LOGICVC_MAX_LAYER_BUFFERS) ||
+		    (layer_buff->id >= ld->buffers))
 			return -EINVAL;
 
 		reg = readl(ld->data->dev_base + LOGICVC_VBUFF_SELECT_ROFF);
@@ -197,12 +175,32 @@ static int xylonfb_layer_buff(struct fb_info *fbi,
 	return 0;
 }
 
+static int xylonfb_layer_buffers(struct fb_info *fbi,
+				 struct xylonfb_layer_buffers *layer_buffers,
+				 bool set)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	u32 max = xylonfb_get_max_buffers(fbi);
+
+	if (set) {
+		if ((layer_buffers->count == 0) || (layer_buffers->count > max))
+			return -EINVAL;
+
+		xylonfb_set_buffers(fbi, layer_buffers->count);
+	} else {
+		layer_buffers->count = ld->buffers;
+		layer_buffers->max = max;
+	}
+
+	return 0;
+}
+
 static void xylonfb_rgb_yuv(u32 c1, u32 c2, u32 c3, u32 *pixel,
 			    struct xylonfb_layer_data *ld, bool rgb2yuv)
 {
 	struct xylonfb_data *data = ld->data;
 	struct xylonfb_layer_fix_data *fd = ld->fd;
-	u32 r, g, b, y, u, v;
+	u32 r, g, b;
 
 	if (rgb2yuv) {
 		switch (fd->format){
@@ -213,33 +211,14 @@ static void xylonfb_rgb_yuv(u32 c1, u32 c2, u32 c3, u32 *pixel,
 		case XYLONFB_FORMAT_AVUY:
 		case XYLONFB_FORMAT_XYUV:
 		case XYLONFB_FORMAT_XVUY:
-			y = ((data->coeff.cyr * c1) + (data->coeff.cyg * c2) +
-				 (data->coeff.cyb * c3) + data->coeff.cy) /
-				 LOGICVC_YUV_NORM;
-			u = ((-data->coeff.cur * c1) - (data->coeff.cug * c2) +
-				 (data->coeff.cub * c3) + LOGICVC_COEFF_U) /
-				 LOGICVC_YUV_NORM;
-			v = ((data->coeff.cvr * c1) - (data->coeff.cvg * c2) -
-				 (data->coeff.cvb * c3) + LOGICVC_COEFF_V) /
-				 LOGICVC_YUV_NORM;
-
-			*pixel = (0xFF << 24) | (y << 16) | (u << 8) | v;
+			*pixel = (0xFF << 24) | xylonfb_rgb2yuv(data, c1, c2, c3);
 			break;
 		case XYLONFB_FORMAT_XYUV_2101010:
 		case XYLONFB_FORMAT_XVUY_2101010:
 		case XYLONFB_FORMAT_YUYV_121010:
 		case XYLONFB_FORMAT_UYVY_121010:
-			y = ((data->coeff.cyr * c1) + (data->coeff.cyg * c2) +
-				 (data->coeff.cyb * c3) + data->coeff.cy) /
-				 LOGICVC_YUV_NORM;
-			u = ((-data->coeff.cur * c1) - (data->coeff.cug * c2) +
-				 (data->coeff.cub * c3) + LOGICVC_COEFF_U) /
-				 LOGICVC_YUV_NORM;
-			v = ((data->coeff.cvr * c1) - (data->coeff.cvg * c2) -
-				 (data->coeff.cvb * c3) + LOGICVC_COEFF_V) /
-				 LOGICVC_YUV_NORM;
-
-			*pixel = (0xFF <<30) | (y << 20) | (u << 10) | v;
+			*pixel = (0x3U << 30) |
+				 xylonfb_rgb2yuv_10(data, c1, c2, c3);
 			break;
 		}
 	} else {
@@ -261,6 +240,7 @@ static int xylonfb_layer_color_rgb(struct xylonfb_layer_data *ld,
 {
 	struct xylonfb_data *data = ld->data;
 	struct xylonfb_layer_fix_data *fd = ld->fd;
+	struct xylonfb_color *color;
 	void __iomem *base;
 	u32 r = 0, g = 0, b = 0;
 	u32 raw_rgb, y, u, v;
@@ -271,14 +251,21 @@ static int xylonfb_layer_color_rgb(struct xylonfb_layer_data *ld,
 		bpp = fd->bpp;
 		format_clut = fd->format_clut;
 		format = fd->format;
+		color = &ld->transp_color;
 	} else /* if (reg_offset == LOGICVC_BACKGROUND_COLOR_ROFF) */ {
 		base = data->dev_base;
 		bpp = data->bg_layer_bpp;
 		format_clut = fd->format_clut;
 		format = fd->format;
+		color = &data->bg_color;
 	}
 
 	if (set) {
+		color->r = layer_color->r;
+		color->g = layer_color->g;
+		color->b = layer_color->b;
+		color->valid = !layer_color->use_raw;
+
 		if (layer_color->use_raw) {
 			raw_rgb = layer_color->raw_rgb;
 		} else if (data->flags & XYLONFB_FLAGS_BACKGROUND_LAYER_YUV) {
@@ -466,6 +453,7 @@ static int xylonfb_layer_geometry(struct fb_info *fbi,
 	struct xylonfb_data *data = ld->data;
 	struct xylonfb_layer_fix_data *fd = ld->fd;
 	u32 x, y, width, height, xoff, yoff, xres, yres;
+	int ret;
 
 	xres = fbi->var.xres;
 	yres = fbi->var.yres;
@@ -491,12 +479,16 @@ static int xylonfb_layer_geometry(struct fb_info *fbi,
 			layer_geometry->height = height;
 		}
 		/* YUV 4:2:2 layer type can only have even layer width */
-		if ((width > 2) && (fd->format == XYLONFB_FORMAT_YUYV ||
-			fd->format == XYLONFB_FORMAT_UYVY ||
-			fd->format == XYLONFB_FORMAT_YUYV_121010 ||
-			fd->format == XYLONFB_FORMAT_UYVY_121010))
+		if ((width > 2) && xylonfb_get_format(fd->format)->yuv422)
 			width &= ~((unsigned long) + 1);
 
+		if (ld->flags & XYLONFB_FLAGS_LAYER_ENABLED) {
+			ret = xylonfb_bw_check(fbi, &fbi->var, width,
+					       true);
+			if (ret)
+				return ret;
+		}
+
 		/*
 		 * logiCVC 3.x registers write sequence:
 		 * offset, size, position with implicit last write to
@@ -529,8 +521,7 @@ static int xylonfb_layer_geometry(struct fb_info *fbi,
 					     ld);
 		if (data->flags & XYLONFB_FLAGS_DYNAMIC_LAYER_ADDRESS) {
 			xoff = layer_geometry->x_offset * (ld->fd->bpp / 8);
-			yoff = layer_geometry->y_offset * ld->fd->width *
-			       (ld->fd->bpp / 8);
+			yoff = layer_geometry->y_offset * fbi->fix.line_length;
 
 			ld->fb_pbase_active = ld->fb_pbase + xoff + yoff;
 
@@ -704,14 +695,135 @@ static int xylonfb_int_stat_reg_access(struct xylonfb_layer_data *ld,
 	return 0;
 }
 
+static void xylonfb_color_reload(struct xylonfb_layer_data *ld,
+				 struct xylonfb_color *color,
+				 unsigned int reg_offset)
+{
+	struct xylonfb_layer_color layer_color;
+
+	if (!color->valid)
+		return;
+
+	layer_color.use_raw = 0;
+	layer_color.r = color->r;
+	layer_color.g = color->g;
+	layer_color.b = color->b;
+
+	xylonfb_layer_color_rgb(ld, &layer_color, reg_offset, true);
+}
+
+/*
+ * Color space change regenerates AYUV CLUTs from layer RGB color maps
+ * and converts YUV background and transparent colors again.
+ * Conversion tables are used by console color map and mode setting,
+ * so they are changed with console locked.
+ */
+static int xylonfb_color_space(struct fb_info *fbi,
+			       struct xylonfb_color_space *color_space,
+			       bool set)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	struct xylonfb_data *data = ld->data;
+	struct fb_info **afbi = dev_get_drvdata(&data->pdev->dev);
+	struct fb_info *layer_fbi;
+	int i, ret;
+
+	if (!set) {
+		color_space->space = data->color_space;
+		color_space->range = data->color_range;
+		return 0;
+	}
+
+	/*
+	 * Driver ioctl is called with fb info locked, while console lock
+	 * is taken first by FBIOPUT_VSCREENINFO. Fb info lock is left
+	 * locked for fb core to unlock after return.
+	 */
+	mutex_unlock(&fbi->lock);
+	console_lock();
+	mutex_lock(&fbi->lock);
+
+	ret = xylonfb_set_color_space(data, color_space->space,
+				      color_space->range);
+	if (ret)
+		goto out;
+
+	for (i = 0; i < data->layers; i++) {
+		layer_fbi = afbi[i];
+		ld = layer_fbi->par;
+
+		mutex_lock(&ld->mutex);
+		if ((ld->fd->format == XYLONFB_FORMAT_C8) &&
+		    (ld->fd->format_clut == XYLONFB_FORMAT_CLUT_AYUV8888) &&
+		    layer_fbi->cmap.len)
+			layer_fbi->fbops->fb_setcmap(&layer_fbi->cmap,
+						     layer_fbi);
+		if (data->flags & XYLONFB_FLAGS_BACKGROUND_LAYER_YUV) {
+			xylonfb_color_reload(ld, &ld->transp_color,
+					     LOGICVC_LAYER_TRANSP_COLOR_ROFF);
+			if (i == 0)
+				xylonfb_color_reload(ld, &data->bg_color,
+					LOGICVC_BACKGROUND_COLOR_ROFF);
+		}
+		mutex_unlock(&ld->mutex);
+	}
+
+out:
+	console_unlock();
+
+	return ret;
+}
+
+/*
+ * Blit is drawn as console copy area, so it uses drawing DMA if available,
+ * and it is finished before return.
+ */
+static int xylonfb_blit(struct fb_info *fbi, struct xylonfb_blit *blit)
+{
+	struct xylonfb_layer_data *ld = fbi->par;
+	struct fb_copyarea area;
+	u32 xres = fbi->var.xres_virtual;
+	u32 yres = fbi->var.yres_virtual;
+
+	if (!blit->width || !blit->height ||
+	    blit->width > xres || blit->height > yres ||
+	    blit->src_x > (xres - blit->width) ||
+	    blit->src_y > (yres - blit->height) ||
+	    blit->dst_x > (xres - blit->width) ||
+	    blit->dst_y > (yres - blit->height))
+		return -EINVAL;
+
+	area.sx = blit->src_x;
+	area.sy = blit->src_y;
+	area.dx = blit->dst_x;
+	area.dy = blit->dst_y;
+	area.width = blit->width;
+	area.height = blit->height;
+
+	/* serialized with console drawing using the same line buffer */
+	console_lock();
+	fbi->fbops->fb_copyarea(fbi, &area);
+	console_unlock();
+
+	/* only blit ioctl waits for drawing DMA sleeping */
+	xylonfb_accel_sync(ld->data, true);
+
+	return 0;
+}
+
 int xylonfb_ioctl(struct fb_info *fbi, unsigned int cmd, unsigned long arg)
 {
 	struct xylonfb_layer_data *ld = fbi->par;
 	struct xylonfb_data *data = ld->data;
 	union {
 		struct fb_vblank vblank;
+		struct xylonfb_blit blit;
+		struct xylonfb_color_space color_space;
+		struct xylonfb_config config;
+		struct xylonfb_field field;
 		struct xylonfb_hw_access hw_access;
 		struct xylonfb_layer_buffer layer_buff;
+		struct xylonfb_layer_buffers layer_buffers;
 		struct xylonfb_layer_color layer_color;
 		struct xylonfb_layer_geometry layer_geometry;
 		struct xylonfb_layer_transparency layer_transp;
@@ -744,7 +856,14 @@ int xylonfb_ioctl(struct fb_info *fbi, unsigned int cmd, unsigned long arg)
 		if (get_user(flag, (u8 __user *)arg))
 			return -EFAULT;
 
-		xylonfb_vsync_ctrl(fbi, flag);
+		/* field parity is tracked by V sync interrupt */
+		mutex_lock(&data->vmode_mutex);
+		if (!flag && (data->vm_active.vmode.vmode &
+			      FB_VMODE_INTERLACED))
+			ret = -EBUSY;
+		else
+			xylonfb_vsync_ctrl(fbi, flag);
+		mutex_unlock(&data->vmode_mutex);
 		break;
 
 	case XYLONFB_LAYER_IDX:
@@ -837,6 +956,21 @@ int xylonfb_ioctl(struct fb_info *fbi, unsigned int cmd, unsigned long arg)
 		mutex_unlock(&ld->mutex);
 		break;
 
+	case XYLONFB_LAYER_BUFFERS:
+		if (copy_from_user(&ioctl.layer_buffers, argp,
+				   sizeof(ioctl.layer_buffers)))
+			return -EFAULT;
+
+		mutex_lock(&ld->mutex);
+		ret = xylonfb_layer_buffers(fbi, &ioctl.layer_buffers,
+					    ioctl.layer_buffers.set);
+		if (!ret && !ioctl.layer_buffers.set)
+			if (copy_to_user(argp, &ioctl.layer_buffers,
+					 sizeof(ioctl.layer_buffers)))
+				ret = -EFAULT;
+		mutex_unlock(&ld->mutex);
+		break;
+
 	case XYLONFB_LAYER_BUFFER_OFFSET:
 		if (data->major < 4) {
 			var32 = readl(ld->data->dev_base +
@@ -845,8 +979,11 @@ int xylonfb_ioctl(struct fb_info *fbi, unsigned int cmd, unsigned long arg)
 			var32 &= 0x03;
 			val = ld->fd->buffer_offset;
 			val *= var32;
-		} else {
+		} else if (ld->fd->buffer_offset) {
 			val = ld->fd->buffer_offset;
+		} else {
+			/* buffers are packed one after another */
+			val = fbi->var.yres;
 		}
 		put_user(val, (unsigned long __user *)arg);
 		break;
@@ -870,6 +1007,19 @@ int xylonfb_ioctl(struct fb_info *fbi, unsigned int cmd, unsigned long arg)
 		mutex_unlock(&ld->mutex);
 		break;
 
+	case XYLONFB_COLOR_SPACE:
+		if (copy_from_user(&ioctl.color_space, argp,
+				   sizeof(ioctl.color_space)))
+			return -EFAULT;
+
+		ret = xylonfb_color_space(fbi, &ioctl.color_space,
+					  ioctl.color_space.set);
+		if (!ret && !ioctl.color_space.set)
+			if (copy_to_user(argp, &ioctl.color_space,
+					 sizeof(ioctl.color_space)))
+				ret = -EFAULT;
+		break;
+
 	case XYLONFB_LAYER_EXT_BUFF_SWITCH:
 		if (get_user(flag, (u8 __user *)arg))
 			return -EFAULT;
@@ -901,6 +1051,33 @@ int xylonfb_ioctl(struct fb_info *fbi, unsigned int cmd, unsigned long arg)
 				ret = -EFAULT;
 		break;
 
+	case XYLONFB_POWER_STATE:
+		var32 = data->pwr_state;
+		put_user(var32, (u32 __user *)arg);
+		break;
+
+	case XYLONFB_BLIT:
+		if (copy_from_user(&ioctl.blit, argp, sizeof(ioctl.blit)))
+			return -EFAULT;
+
+		ret = xylonfb_blit(fbi, &ioctl.blit);
+		break;
+
+	case XYLONFB_FIELD:
+		xylonfb_get_field(&ioctl.field, fbi);
+		if (copy_to_user(argp, &ioctl.field, sizeof(ioctl.field)))
+			ret = -EFAULT;
+		break;
+
+	case XYLONFB_CONFIG_TEST:
+		if (copy_from_user(&ioctl.config, argp, sizeof(ioctl.config)))
+			return -EFAULT;
+
+		ret = xylonfb_config_test(fbi, &ioctl.config);
+		if (copy_to_user(argp, &ioctl.config, sizeof(ioctl.config)))
+			ret = -EFAULT;
+		break;
+
 	case XYLONFB_IP_CORE_VERSION:
 		var32 = (data->major << 16) | (data->minor << 8) | data->patch;
 		if (copy_to_user(argp, &var32, sizeof(u32)))
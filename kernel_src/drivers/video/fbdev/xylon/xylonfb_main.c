@@ -15,6 +15,7 @@
  */
 
 #include <linux/errno.h>
+#include <linux/log2.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_address.h>
@@ -23,10 +24,14 @@
 #include <video/of_display_timing.h>
 #include <video/of_videomode.h>
 #include <video/videomode.h>
+#include <uapi/linux/xylonfb.h>
 
 #include "xylonfb_core.h"
 #include "logicvc.h"
 
+/* Video mode from kernel boot options, shared by all devices */
+static char *xylonfb_mode_option;
+
 static void xylonfb_init_ctrl(struct device_node *dn, enum display_flags flags,
 			      u32 *ctrl)
 {
@@ -105,6 +110,8 @@ static int xylonfb_layer_set_format(struct xylonfb_layer_fix_data *fd,
 				else
 					fd->format = XYLONFB_FORMAT_ARGB565;
 				break;
+			default:
+				return -EINVAL;
 			}
 			break;
 		case 30:
@@ -191,46 +198,15 @@ static int xylonfb_layer_set_format(struct xylonfb_layer_fix_data *fd,
 					return -EINVAL;
 			}
 			break;
+		default:
+			return -EINVAL;
 		}
 		break;
 	default:
 		dev_err(dev, "unsupported layer type\n");
 		return -EINVAL;
 	}
-	switch (fd->format) {
-	case XYLONFB_FORMAT_A8:
-	case XYLONFB_FORMAT_C8:
-	case XYLONFB_FORMAT_RGB332:
-	case XYLONFB_FORMAT_BGR233:
-		fd->bpp = 8;
-		break;
-	case XYLONFB_FORMAT_ARGB3332:
-	case XYLONFB_FORMAT_ABGR3233:
-	case XYLONFB_FORMAT_RGB565:
-	case XYLONFB_FORMAT_BGR565:
-	case XYLONFB_FORMAT_YUYV:
-	case XYLONFB_FORMAT_UYVY:
-		fd->bpp = 16;
-		break;
-	case XYLONFB_FORMAT_ARGB565:
-	case XYLONFB_FORMAT_ABGR565:
-	case XYLONFB_FORMAT_XRGB8888:
-	case XYLONFB_FORMAT_XBGR8888:
-	case XYLONFB_FORMAT_ARGB8888:
-	case XYLONFB_FORMAT_ABGR8888:
-	case XYLONFB_FORMAT_XRGB2101010:
-	case XYLONFB_FORMAT_XBGR2101010:
-	case XYLONFB_FORMAT_YUYV_121010:
-	case XYLONFB_FORMAT_UYVY_121010:
-	case XYLONFB_FORMAT_AYUV:
-	case XYLONFB_FORMAT_AVUY:
-	case XYLONFB_FORMAT_XYUV:
-	case XYLONFB_FORMAT_XVUY:
-	case XYLONFB_FORMAT_XYUV_2101010:
-	case XYLONFB_FORMAT_XVUY_2101010:
-		fd->bpp = 32;
-		break;
-	}
+	fd->bpp = xylonfb_get_format(fd->format)->bpp;
 
 	return 0;
 }
@@ -278,6 +254,18 @@ static int xylonfb_parse_layer_info(struct device_node *parent_dn,
 		return ret;
 	}
 
+	ret = of_property_read_u32(dn, "buffers", &fd->buffers);
+	if (ret && (ret != -EINVAL)) {
+		dev_err(dev, "failed get buffers\n");
+		return ret;
+	} else if (ret) {
+		fd->buffers = LOGICVC_MAX_LAYER_BUFFERS;
+	}
+	if ((fd->buffers == 0) || (fd->buffers > XYLONFB_MAX_LAYER_BUFFERS)) {
+		dev_err(dev, "invalid buffers value\n");
+		return -EINVAL;
+	}
+
 	ret = of_property_read_u32(dn, "bits-per-pixel", &fd->bpp);
 	if (ret) {
 		dev_err(dev, "failed get bits-per-pixel\n");
@@ -384,6 +372,26 @@ static int xylon_parse_hw_info(struct device_node *dn,
 	if (of_property_read_bool(dn, "display-interface-itu656"))
 		data->flags |= XYLONFB_FLAGS_DISPLAY_INTERFACE_ITU656;
 
+	ret = of_property_read_string(dn, "color-space", &string);
+	if (ret && (ret != -EINVAL)) {
+		dev_err(dev, "failed get color-space\n");
+		return ret;
+	} else if (!ret) {
+		if (!strcmp(string, "bt601")) {
+			data->color_space = XYLONFB_COLOR_SPACE_BT601;
+		} else if (!strcmp(string, "bt709")) {
+			data->color_space = XYLONFB_COLOR_SPACE_BT709;
+		} else if (!strcmp(string, "bt2020")) {
+			data->color_space = XYLONFB_COLOR_SPACE_BT2020;
+		} else {
+			dev_err(dev, "unsupported color-space\n");
+			return -EINVAL;
+		}
+	}
+
+	if (of_property_read_bool(dn, "color-range-limited"))
+		data->color_range = XYLONFB_COLOR_RANGE_LIMITED;
+
 	if (of_property_read_bool(dn, "readable-regs"))
 	{
 		data->flags |= XYLONFB_FLAGS_READABLE_REGS;
@@ -403,6 +411,37 @@ static int xylon_parse_hw_info(struct device_node *dn,
 		return ret;
 	}
 
+	ret = of_property_read_u32(dn, "burst-size", &data->burst_size);
+	if (ret && (ret != -EINVAL)) {
+		dev_err(dev, "failed get burst-size\n");
+		return ret;
+	} else if (ret) {
+		data->burst_size = XYLONFB_BURST_SIZE_DEFAULT;
+	}
+	if (!is_power_of_2(data->burst_size) ||
+	    (data->burst_size > PAGE_SIZE)) {
+		dev_err(dev, "invalid burst-size value\n");
+		return -EINVAL;
+	}
+
+	ret = of_property_read_u32(dn, "memory-bandwidth", &data->mem_bw);
+	if (ret && (ret != -EINVAL)) {
+		dev_err(dev, "failed get memory-bandwidth\n");
+		return ret;
+	}
+
+	ret = of_property_read_u32(dn, "cvt-reduced-blanking", &data->cvt_rb);
+	if (ret && (ret != -EINVAL)) {
+		dev_err(dev, "failed get cvt-reduced-blanking\n");
+		return ret;
+	} else if (ret) {
+		data->cvt_rb = XYLONFB_CVT_RB_DEFAULT;
+	}
+	if (data->cvt_rb > XYLONFB_CVT_RB_V2) {
+		dev_err(dev, "invalid cvt-reduced-blanking value\n");
+		return -EINVAL;
+	}
+
 	ret = of_property_read_u32(dn, "power-delay", &data->pwr_delay);
 	if (ret && (ret != -EINVAL)) {
 		dev_err(dev, "failed get power-delay\n");
@@ -510,7 +549,7 @@ static int xylonfb_get_driver_configuration(struct xylonfb_data *data)
 		return -ENODEV;
 	}
 
-	data->pixel_clock = of_parse_phandle(dn, "clocks", 0);
+	data->pixel_clock.dn = of_parse_phandle(dn, "clocks", 0);
 
 	ret = of_property_read_u32(dn, "console-layer", &data->console_layer);
 	if (ret && (ret != -EINVAL)) {
@@ -531,6 +570,9 @@ static int xylonfb_get_driver_configuration(struct xylonfb_data *data)
 		data->flags |= XYLONFB_FLAGS_ADV7511_SKIP;
 	}
 
+	if (of_property_read_bool(dn, "seamless-handoff"))
+		data->flags |= XYLONFB_FLAGS_SEAMLESS_HANDOFF;
+
 	ret = of_property_read_string(dn, "video-mode", &string);
 	if (ret && (ret != -EINVAL) && !(data->flags & XYLONFB_FLAGS_EDID_VMODE)) {
 		dev_err(dev, "failed get video-mode\n");
@@ -561,6 +603,7 @@ static int xylonfb_probe(struct platform_device *pdev)
 	}
 
 	data->pdev = pdev;
+	data->vmode_option = xylonfb_mode_option;
 
 	ret = xylonfb_get_driver_configuration(data);
 	if (ret)
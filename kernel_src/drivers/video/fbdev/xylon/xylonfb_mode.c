@@ -0,0 +1,258 @@
+/*
+ * Xylon logiCVC frame buffer driver video mode index
+ *
+ * Copyright (C) 2016 Xylon d.o.o.
+ * Author: Davor Joja <davor.joja@logicbricks.com>
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Video modes are indexed by resolution in per device hash table.
+ * Index holds display EDID modes if EDID video mode is used, and modes
+ * resolved by fb_find_mode() or CVT calculation which are added at the
+ * first use, so repeated mode sets do not parse mode strings and search
+ * mode databases again.
+ */
+
+#include <linux/device.h>
+#include <linux/fb.h>
+#include <linux/hashtable.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "xylonfb_core.h"
+
+static u32 xylonfb_mode_key(u32 xres, u32 yres)
+{
+	return (xres << 16) | yres;
+}
+
+u32 xylonfb_mode_flags(const struct xylonfb_vmode *vm)
+{
+	u32 flags = 0;
+
+	if (strchr(vm->opts_cvt, 'M'))
+		flags |= XYLONFB_MODE_CVT;
+	if (strchr(vm->opts_cvt, 'R'))
+		flags |= XYLONFB_MODE_CVT_RB;
+	if (strchr(vm->opts_ext, 'i'))
+		flags |= XYLONFB_MODE_INTERLACED;
+	if (strchr(vm->opts_ext, 'm'))
+		flags |= XYLONFB_MODE_MARGINS;
+
+	return flags;
+}
+
+static u32 xylonfb_mode_refresh(u32 pixclk_khz, u32 htotal, u32 vtotal)
+{
+	if (!htotal || !vtotal)
+		return 0;
+
+	return DIV_ROUND_CLOSEST(pixclk_khz * 1000, htotal * vtotal);
+}
+
+/*
+ * Returns refresh rate requested by screen info timings,
+ * or 0 if screen info has no pixel clock.
+ */
+u32 xylonfb_mode_var_refresh(const struct fb_var_screeninfo *var)
+{
+	u32 htotal, vtotal;
+
+	if (!var->pixclock)
+		return 0;
+
+	htotal = var->xres + var->left_margin + var->right_margin +
+		 var->hsync_len;
+	vtotal = var->yres + var->upper_margin + var->lower_margin +
+		 var->vsync_len;
+
+	return xylonfb_mode_refresh(PICOS2KHZ(var->pixclock), htotal, vtotal);
+}
+
+/*
+ * Fits video mode totals to pixel clock frequency the clock can generate.
+ * Front porches are adjusted so frame time, i.e. refresh rate, stays as
+ * close as possible to the one of requested timings, instead of drifting
+ * by the clock frequency error. Returns refresh rate of fitted timings
+ * in mHz, and fitted line and frame totals.
+ */
+u32 xylonfb_mode_fit(const struct fb_videomode *vm, unsigned long round_khz,
+		     u32 *htotal_fit, u32 *vtotal_fit)
+{
+	unsigned long pixclk_khz = PICOS2KHZ(vm->pixclock);
+	u64 frame, err, best_err;
+	u32 htotal, vtotal, h, v, best_h, best_v;
+	int dv;
+
+	htotal = vm->xres + vm->left_margin + vm->right_margin +
+		 vm->hsync_len;
+	vtotal = vm->yres + vm->upper_margin + vm->lower_margin +
+		 vm->vsync_len;
+
+	/* frame length in pixels at achievable clock, times pixclk_khz */
+	frame = (u64)htotal * vtotal * round_khz;
+	best_h = htotal;
+	best_v = vtotal;
+	best_err = abs((s64)frame -
+		       (s64)((u64)htotal * vtotal * pixclk_khz));
+
+	for (dv = -XYLONFB_VMODE_FIT_LINES;
+	     (round_khz != pixclk_khz) && (dv <= XYLONFB_VMODE_FIT_LINES);
+	     dv++) {
+		if (((int)vm->lower_margin + dv) < 1)
+			continue;
+		v = vtotal + dv;
+		h = div64_u64(frame + ((u64)v * pixclk_khz / 2),
+			      (u64)v * pixclk_khz);
+		if (((int)vm->right_margin + (int)h - (int)htotal) < 1)
+			continue;
+
+		err = abs((s64)frame - (s64)((u64)h * v * pixclk_khz));
+		if ((err < best_err) ||
+		    ((err == best_err) &&
+		     (abs(dv) < abs((int)best_v - (int)vtotal)))) {
+			best_err = err;
+			best_h = h;
+			best_v = v;
+		}
+	}
+
+	*htotal_fit = best_h;
+	*vtotal_fit = best_v;
+
+	return div64_u64((u64)round_khz * 1000000, (u64)best_h * best_v);
+}
+
+static void xylonfb_mode_reset(struct xylonfb_mode_db *db)
+{
+	hash_init(db->hash);
+	db->preferred = NULL;
+	db->count = 0;
+}
+
+const struct xylonfb_mode *xylonfb_mode_add(struct xylonfb_data *data,
+					    const struct fb_videomode *vm,
+					    u32 flags)
+{
+	struct xylonfb_mode_db *db = &data->mode_db;
+	struct xylonfb_mode *mode;
+	u32 htotal, vtotal, refresh;
+
+	/* full index only stops caching, modes are still resolved */
+	if (!db->modes || (db->count == XYLONFB_MODE_DB_SIZE) || !vm->pixclock)
+		return NULL;
+
+	mode = &db->modes[db->count++];
+	mode->vmode = *vm;
+	mode->key = xylonfb_mode_key(vm->xres, vm->yres);
+	mode->flags = flags;
+	mode->pixclk_khz = PICOS2KHZ(vm->pixclock);
+
+	htotal = vm->xres + vm->left_margin + vm->right_margin + vm->hsync_len;
+	vtotal = vm->yres + vm->upper_margin + vm->lower_margin +
+		 vm->vsync_len;
+	refresh = xylonfb_mode_refresh(mode->pixclk_khz, htotal, vtotal);
+	if (refresh)
+		mode->vmode.refresh = refresh;
+
+	hash_add(db->hash, &mode->node, mode->key);
+
+	return mode;
+}
+
+/*
+ * Returns mode of given resolution and flags with refresh rate closest to
+ * requested one, or NULL if no mode is within refresh tolerance.
+ * Of equally close modes, EDID preferred mode is returned, otherwise the
+ * one added first, same as fb_find_mode() does with its mode database
+ * order. Refresh rate 0 matches any mode.
+ */
+const struct xylonfb_mode *xylonfb_mode_find(struct xylonfb_data *data,
+					     u32 xres, u32 yres, u32 refresh,
+					     u32 flags)
+{
+	struct xylonfb_mode_db *db = &data->mode_db;
+	struct xylonfb_mode *mode, *best = NULL;
+	u32 key = xylonfb_mode_key(xres, yres);
+	u32 diff, best_diff = 0;
+
+	hash_for_each_possible(db->hash, mode, node, key) {
+		if ((mode->key != key) || (mode->flags != flags))
+			continue;
+
+		diff = refresh ? abs((int)mode->vmode.refresh - (int)refresh) :
+		       0;
+		if (!best || (diff < best_diff) ||
+		    ((diff == best_diff) && (best != db->preferred) &&
+		     ((mode == db->preferred) || (mode < best)))) {
+			best = mode;
+			best_diff = diff;
+		}
+	}
+
+	if (best_diff > XYLONFB_MODE_REFRESH_TOLERANCE)
+		return NULL;
+
+	return best;
+}
+
+/*
+ * Rebuilds index from display EDID modes if EDID video mode is used,
+ * otherwise drops EDID modes from the index.
+ */
+void xylonfb_mode_update(struct xylonfb_data *data,
+			 const struct fb_monspecs *monspecs)
+{
+	struct xylonfb_mode_db *db = &data->mode_db;
+	const struct fb_videomode *modedb = NULL;
+	u32 i, len = 0;
+
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	if ((data->flags & XYLONFB_FLAGS_EDID_VMODE) &&
+	    (data->flags & XYLONFB_FLAGS_EDID_READY)) {
+		modedb = monspecs->modedb;
+		len = monspecs->modedb_len;
+	}
+
+	xylonfb_mode_reset(db);
+	db->edid = modedb;
+
+	for (i = 0; i < len; i++)
+		xylonfb_mode_add(data, &modedb[i], 0);
+
+	if (len && (monspecs->misc & FB_MISC_1ST_DETAIL))
+		db->preferred = &db->modes[0];
+}
+
+int xylonfb_mode_init(struct xylonfb_data *data)
+{
+	struct device *dev = &data->pdev->dev;
+	struct xylonfb_mode_db *db = &data->mode_db;
+
+	XYLONFB_DBG(INFO, "%s", __func__);
+
+	db->modes = devm_kzalloc(dev,
+				 sizeof(*db->modes) * XYLONFB_MODE_DB_SIZE,
+				 GFP_KERNEL);
+	if (!db->modes) {
+		dev_err(dev, "failed allocate video mode index\n");
+		return -ENOMEM;
+	}
+
+	xylonfb_mode_reset(db);
+	db->edid = NULL;
+
+	return 0;
+}
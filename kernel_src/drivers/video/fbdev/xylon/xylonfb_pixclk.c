@@ -21,18 +21,16 @@
 
 #include "xylonfb_core.h"
 
-struct xylonfb_pixclk {
-	struct device *dev;
-	struct device_node *dn;
-	struct clk *clk;
-};
+/*
+ * Pixel clock state is kept per device in struct xylonfb_pixclk, so
+ * several logiCVC devices can run with independent pixel clocks.
+ */
 
 #if defined(CONFIG_FB_XYLON_PIXCLK_LOGICLK)
 static const struct of_device_id logiclk_of_match[] = {
 	{ .compatible = "xylon,logiclk-1.02.b" },
 	{/* end of table */}
 };
-static struct xylonfb_pixclk logiclk;
 #endif
 
 #if defined(CONFIG_FB_XYLON_PIXCLK_SI570)
@@ -40,76 +38,69 @@ static const struct of_device_id si570_of_match[] = {
 	{ .compatible = "silabs,si570" },
 	{/* end of table */}
 };
-static struct xylonfb_pixclk si570;
 #endif
 
-bool xylonfb_hw_pixclk_supported(struct device *dev, struct device_node *dn);
-void xylonfb_hw_pixclk_unload(struct device_node *dn);
-int xylonfb_hw_pixclk_set(struct device *dev, struct device_node *dn,
-			  unsigned long pixclk_khz);
+bool xylonfb_hw_pixclk_supported(struct xylonfb_data *data);
+void xylonfb_hw_pixclk_unload(struct xylonfb_data *data);
+int xylonfb_hw_pixclk_set(struct xylonfb_data *data, unsigned long pixclk_khz);
+int xylonfb_hw_pixclk_round(struct xylonfb_data *data,
+			    unsigned long pixclk_khz,
+			    unsigned long *round_khz);
 
 #if defined(CONFIG_FB_XYLON_PIXCLK)
-static int xylonfb_hw_pixclk_set_freq(struct device *dev,
-				      struct device_node *dn,
+static int xylonfb_hw_pixclk_set_freq(struct xylonfb_data *data,
 				      unsigned long freq_khz)
 {
-	struct clk *clk = NULL;
+	struct xylonfb_pixclk *pixclk = &data->pixel_clock;
 
-#if defined(CONFIG_FB_XYLON_PIXCLK_LOGICLK)
-	if (dn == logiclk.dn)
-		clk = logiclk.clk;
-#endif
+	XYLONFB_DBG(INFO, "%s clk %p: freq_khz %lu", __func__,
+		    pixclk->clk, freq_khz);
 
-#if defined(CONFIG_FB_XYLON_PIXCLK_SI570)
-	if (dn == si570.dn)
-		clk = si570.clk;
-#endif
-	XYLONFB_DBG(INFO, "%s clk %p: freq_khz %d", __func__, clk, freq_khz);
+	if (!pixclk->clk || (freq_khz == pixclk->rate_khz))
+		return 0;
 
-	if (clk && clk_set_rate(clk, (freq_khz * 1000))) {
-		dev_err(dev, "failed set pixel clock frequency\n");
+	if (clk_set_rate(pixclk->clk, (freq_khz * 1000))) {
+		dev_err(&data->pdev->dev,
+			"failed set pixel clock frequency\n");
 		return -EINVAL;
 	}
+	pixclk->rate_khz = freq_khz;
 
 	return 0;
 }
 #endif
 
-bool xylonfb_hw_pixclk_supported(struct device *dev, struct device_node *dn)
+bool xylonfb_hw_pixclk_supported(struct xylonfb_data *data)
 {
 #if defined(CONFIG_FB_XYLON_PIXCLK)
-	struct clk **clk;
+	struct device *dev = &data->pdev->dev;
+	struct xylonfb_pixclk *pixclk = &data->pixel_clock;
+	struct clk *clk;
 	bool clk_dev = false;
 
 #if defined(CONFIG_FB_XYLON_PIXCLK_LOGICLK)
-	if (of_match_node(logiclk_of_match, of_get_parent(dn))) {
-		clk = &logiclk.clk;
-		logiclk.dev = dev;
-		logiclk.dn = dn;
+	if (of_match_node(logiclk_of_match, of_get_parent(pixclk->dn)))
 		clk_dev = true;
-	}
 #endif
 
 #if defined(CONFIG_FB_XYLON_PIXCLK_SI570)
-	if (of_match_node(si570_of_match, dn)) {
-		clk = &si570.clk;
-		si570.dev = dev;
-		si570.dn = dn;
+	if (of_match_node(si570_of_match, pixclk->dn))
 		clk_dev = true;
-	}
 #endif
 
 	if (clk_dev) {
-		*clk = devm_clk_get(dev, NULL);
-		if (IS_ERR(*clk)) {
+		clk = devm_clk_get(dev, NULL);
+		if (IS_ERR(clk)) {
 			dev_err(dev, "failed get pixel clock\n");
 			return false;
 		}
-		if (clk_prepare_enable(*clk)) {
+		if (clk_prepare_enable(clk)) {
 			dev_err(dev,
 				"failed prepare/enable pixel clock\n");
 			return false;
 		}
+		pixclk->clk = clk;
+		pixclk->rate_khz = clk_get_rate(clk) / 1000;
 
 		return true;
 	} else {
@@ -120,28 +111,47 @@ bool xylonfb_hw_pixclk_supported(struct device *dev, struct device_node *dn)
 #endif
 }
 
-void xylonfb_hw_pixclk_unload(struct device_node *dn)
+void xylonfb_hw_pixclk_unload(struct xylonfb_data *data)
 {
-	struct clk *clk = NULL;
+	struct xylonfb_pixclk *pixclk = &data->pixel_clock;
 
-#if defined(CONFIG_FB_XYLON_PIXCLK_LOGICLK)
-	clk = logiclk.clk;
-#endif
-#if defined(CONFIG_FB_XYLON_PIXCLK_SI570)
-	clk = si570.clk;
-#endif
+	if (pixclk->clk)
+		clk_disable_unprepare(pixclk->clk);
+	pixclk->clk = NULL;
+}
 
-	if (clk)
-		clk_disable_unprepare(clk);
+int xylonfb_hw_pixclk_set(struct xylonfb_data *data, unsigned long pixclk_khz)
+{
+#if defined(CONFIG_FB_XYLON_PIXCLK)
+	return xylonfb_hw_pixclk_set_freq(data, pixclk_khz);
+#else
+	dev_warn(&data->pdev->dev, "pixel clock control not supported\n");
+	return -ENODEV;
+#endif
 }
 
-int xylonfb_hw_pixclk_set(struct device *dev, struct device_node *dn,
-			  unsigned long pixclk_khz)
+/* Returns frequency pixel clock would run at, without changing it */
+int xylonfb_hw_pixclk_round(struct xylonfb_data *data,
+			    unsigned long pixclk_khz,
+			    unsigned long *round_khz)
 {
 #if defined(CONFIG_FB_XYLON_PIXCLK)
-	return xylonfb_hw_pixclk_set_freq(dev, dn, pixclk_khz);
+	struct clk *clk = data->pixel_clock.clk;
+	long rate;
+
+	if (!clk) {
+		*round_khz = pixclk_khz;
+		return 0;
+	}
+
+	rate = clk_round_rate(clk, pixclk_khz * 1000);
+	if (rate <= 0)
+		return -EINVAL;
+
+	*round_khz = rate / 1000;
+
+	return 0;
 #else
-	dev_warn(dev, "pixel clock control not supported\n");
 	return -ENODEV;
 #endif
 }
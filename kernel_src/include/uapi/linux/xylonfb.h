@@ -31,6 +31,12 @@ struct xylonfb_layer_buffer {
 	bool set;
 };
 
+struct xylonfb_layer_buffers {
+	__u8 count;
+	__u8 max;
+	bool set;
+};
+
 struct xylonfb_layer_color {
 	__u32 raw_rgb;
 	__u8 use_raw;
@@ -40,6 +46,95 @@ struct xylonfb_layer_color {
 	bool set;
 };
 
+/* RGB to YUV conversion color space */
+#define XYLONFB_COLOR_SPACE_DEFAULT	0
+#define XYLONFB_COLOR_SPACE_BT601	1
+#define XYLONFB_COLOR_SPACE_BT709	2
+#define XYLONFB_COLOR_SPACE_BT2020	3
+
+#define XYLONFB_COLOR_RANGE_FULL	0
+#define XYLONFB_COLOR_RANGE_LIMITED	1
+
+struct xylonfb_color_space {
+	__u8 space;
+	__u8 range;
+	bool set;
+};
+
+/* Display power sequence state */
+#define XYLONFB_POWER_OFF	0
+#define XYLONFB_POWER_VDD	1
+#define XYLONFB_POWER_SIGNAL	2
+#define XYLONFB_POWER_ON	3
+
+/*
+ * Field scanned out, counted per field in interlaced video mode.
+ * logiCVC has no field status, so field parity is tracked by driver,
+ * toggled on each V sync interrupt from top field at output enable.
+ * XYLONFB_VSYNC_CTRL cannot disable V sync interrupt while interlaced,
+ * and fails with EBUSY.
+ */
+#define XYLONFB_FIELD_TOP	0
+#define XYLONFB_FIELD_BOTTOM	1
+
+struct xylonfb_field {
+	__u32 count;
+	__u8 field;
+	bool interlaced;
+};
+
+/* Copy of layer rectangle, in pixels of layer virtual resolution */
+struct xylonfb_blit {
+	__u32 src_x;
+	__u32 src_y;
+	__u32 dst_x;
+	__u32 dst_y;
+	__u32 width;
+	__u32 height;
+};
+
+/* Candidate configuration checked by XYLONFB_CONFIG_TEST */
+#define XYLONFB_CONFIG_MAX_LAYERS	5
+
+#define XYLONFB_CONFIG_FAIL_TIMINGS	(1 << 0)
+#define XYLONFB_CONFIG_FAIL_RESOLUTION	(1 << 1)
+#define XYLONFB_CONFIG_FAIL_PIXCLK	(1 << 2)
+#define XYLONFB_CONFIG_FAIL_GEOMETRY	(1 << 3)
+#define XYLONFB_CONFIG_FAIL_BPP		(1 << 4)
+#define XYLONFB_CONFIG_FAIL_MEMORY	(1 << 5)
+#define XYLONFB_CONFIG_FAIL_BANDWIDTH	(1 << 6)
+
+/* Layer width or height 0 means full screen layer */
+struct xylonfb_config_layer {
+	__u16 x;
+	__u16 y;
+	__u16 width;
+	__u16 height;
+	__u8 bits_per_pixel;
+	__u8 buffers;
+	bool enable;
+};
+
+/*
+ * Timings in struct fb_var_screeninfo units. fail and refresh_mhz, refresh
+ * rate in mHz of timings fitted to achievable pixel clock, are set by
+ * driver.
+ */
+struct xylonfb_config {
+	__u32 pixclock;
+	__u32 xres;
+	__u32 yres;
+	__u32 left_margin;
+	__u32 right_margin;
+	__u32 upper_margin;
+	__u32 lower_margin;
+	__u32 hsync_len;
+	__u32 vsync_len;
+	struct xylonfb_config_layer layer[XYLONFB_CONFIG_MAX_LAYERS];
+	__u32 fail;
+	__u32 refresh_mhz;
+};
+
 struct xylonfb_layer_geometry {
 	__u16 x;
 	__u16 y;
@@ -90,5 +185,14 @@ struct xylonfb_layer_transparency {
 /* accesses int_stat register */
 #define XYLONFB_HW_ACCESS_INT_STAT_REG \
 	XYLONFB_IOR(46, struct xylonfb_hw_access)
+#define XYLONFB_LAYER_BUFFERS \
+	XYLONFB_IOR(47, struct xylonfb_layer_buffers)
+#define XYLONFB_COLOR_SPACE \
+	XYLONFB_IOR(48, struct xylonfb_color_space)
+#define XYLONFB_POWER_STATE		XYLONFB_IOR(49, __u32)
+#define XYLONFB_BLIT			XYLONFB_IOW(50, struct xylonfb_blit)
+#define XYLONFB_CONFIG_TEST \
+	XYLONFB_IOWR(51, struct xylonfb_config)
+#define XYLONFB_FIELD			XYLONFB_IOR(52, struct xylonfb_field)
 
 #endif /* __XYLONFB_H__ */
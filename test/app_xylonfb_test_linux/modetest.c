@@ -0,0 +1,137 @@
+/*
+ * Xylon logiCVC frame buffer driver video mode refresh rate test
+ *
+ * Sets current resolution alternately with two refresh rates, by scaling
+ * pixel clock of screen info timings, and checks that driver resolves
+ * each request to video mode with requested refresh rate, both when video
+ * mode is generated and when it is found in driver video mode index.
+ * Original screen info is restored at the end.
+ *
+ * Usage: modetest /dev/fb* [refresh1 refresh2]
+ *   refresh1 refresh2  refresh rates in Hz, default 60 and 50
+ *
+ * Copyright (C) 2016 Xylon d.o.o.
+ * Author: Davor Joja <davor.joja@logicbricks.com>
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <sys/ioctl.h>
+
+/* Hz, same as driver video mode index tolerance */
+#define REFRESH_TOLERANCE	1
+#define REPEAT			2
+
+static unsigned long long total(const struct fb_var_screeninfo *var)
+{
+	unsigned long long htotal, vtotal;
+
+	htotal = var->xres + var->left_margin + var->right_margin +
+		 var->hsync_len;
+	vtotal = var->yres + var->upper_margin + var->lower_margin +
+		 var->vsync_len;
+
+	return htotal * vtotal;
+}
+
+static unsigned int refresh(const struct fb_var_screeninfo *var)
+{
+	unsigned long long frame;
+
+	if (!var->pixclock)
+		return 0;
+
+	/* picoseconds */
+	frame = total(var) * var->pixclock;
+
+	return (1000000000000ULL + (frame / 2)) / frame;
+}
+
+static int test_refresh(int fbfd, const struct fb_var_screeninfo *orig,
+			unsigned int rate)
+{
+	struct fb_var_screeninfo vinfo = *orig;
+	unsigned int result;
+
+	vinfo.pixclock = 1000000000000ULL / (total(orig) * rate);
+	vinfo.activate = FB_ACTIVATE_NOW;
+
+	if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &vinfo) ||
+	    ioctl(fbfd, FBIOGET_VSCREENINFO, &vinfo)) {
+		perror("IOCTL Error");
+		return -errno;
+	}
+
+	result = refresh(&vinfo);
+	printf("%dx%d@%u: %dx%d@%u, pixel clock %u ps\n",
+	       orig->xres, orig->yres, rate,
+	       vinfo.xres, vinfo.yres, result, vinfo.pixclock);
+
+	if ((vinfo.xres != orig->xres) || (vinfo.yres != orig->yres) ||
+	    (abs((int)result - (int)rate) > REFRESH_TOLERANCE))
+		return -EINVAL;
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct fb_var_screeninfo orig;
+	unsigned int rate[2] = { 60, 50 };
+	int fbfd, i;
+	int ret = 0;
+
+	if (argc < 2) {
+		puts("Usage: modetest /dev/fb* [refresh1 refresh2]");
+		return -1;
+	}
+	if (argc >= 4) {
+		rate[0] = strtoul(argv[2], 0, 0);
+		rate[1] = strtoul(argv[3], 0, 0);
+	}
+	if (!rate[0] || !rate[1] || (rate[0] == rate[1])) {
+		puts("Refresh rates must differ and not be 0");
+		return -1;
+	}
+
+	fbfd = open(argv[1], O_RDWR);
+	if (fbfd < 0) {
+		printf("Error opening framebuffer device %s\n", argv[1]);
+		perror(NULL);
+		return -errno;
+	}
+
+	if (ioctl(fbfd, FBIOGET_VSCREENINFO, &orig)) {
+		perror("IOCTL Error");
+		close(fbfd);
+		return -errno;
+	}
+
+	/* first pass adds video modes to index, second finds them */
+	for (i = 0; i < (2 * REPEAT); i++)
+		if (test_refresh(fbfd, &orig, rate[i & 1]))
+			ret = -EINVAL;
+
+	orig.activate = FB_ACTIVATE_NOW;
+	if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &orig))
+		perror("IOCTL Error");
+
+	close(fbfd);
+
+	puts(ret ? "FAILED" : "PASSED");
+
+	return ret;
+}
@@ -0,0 +1,314 @@
+/*
+ * Xylon logiCVC frame buffer driver RGB to YUV conversion test
+ *
+ * Converts all 2^24 RGB colors with the driver, by setting them as layer
+ * transparent color and reading back the layer register, and compares
+ * results with the reference integer formula of each color space.
+ * Results out of component range are expected clamped.
+ * Background layer must be YUV, so the driver converts layer colors.
+ * Layer transparent color and color space are restored at the end.
+ *
+ * Usage: yuvtest /dev/fb* [itu656] [space range]
+ *   itu656       driver default coefficients are for ITU656 interface
+ *   space range  test only given color space and range
+ *
+ * Copyright (C) 2016 Xylon d.o.o.
+ * Author: Davor Joja <davor.joja@logicbricks.com>
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <linux/types.h>
+#include <linux/videodev2.h>
+#include <sys/ioctl.h>
+
+#include "xylonfb.h"
+
+#define LOGICVC_LAYER_BASE_OFFSET	0x100
+#define LOGICVC_LAYER_OFFSET		0x80
+#define LOGICVC_LAYER_TRANSP_COLOR_ROFF	0x40
+
+#define LOGICVC_YUV_NORM		100000
+
+#define LOGICVC_PIX_FMT_YUYV_121010	v4l2_fourcc('Y', 'U', '2', '0')
+#define LOGICVC_PIX_FMT_UYVY_121010	v4l2_fourcc('U', 'Y', '2', '0')
+#define LOGICVC_PIX_FMT_XYUV_2101010	v4l2_fourcc('X', 'Y', '3', '0')
+
+struct coeff {
+	int cy, cyr, cyg, cyb;
+	int cu, cur, cug, cub;
+	int cv, cvr, cvg, cvb;
+};
+
+/* logiCVC coefficients, default and for ITU656 display interface */
+static const struct coeff coeff_default = {
+	0, 29900, 58700, 11400,
+	12800000, 16868, 33107, 49970,
+	12800000, 49980, 41850, 8128,
+};
+
+static const struct coeff coeff_itu656 = {
+	1600000, 29900, 58700, 11400,
+	12800000, 17258, 33881, 51140,
+	12800000, 51138, 42820, 8316,
+};
+
+/* BT.601, BT.709 and BT.2020, full and limited range */
+static const struct coeff coeff_space[3][2] = {
+	{
+		{ 50000, 29900, 58700, 11400,
+		  12850000, 16874, 33126, 50000,
+		  12850000, 50000, 41869, 8131 },
+		{ 1650000, 25679, 50413, 9791,
+		  12850000, 14822, 29100, 43922,
+		  12850000, 43922, 36779, 7143 },
+	},
+	{
+		{ 50000, 21260, 71520, 7220,
+		  12850000, 11457, 38543, 50000,
+		  12850000, 50000, 45415, 4585 },
+		{ 1650000, 18259, 61423, 6201,
+		  12850000, 10064, 33858, 43922,
+		  12850000, 43922, 39895, 4027 },
+	},
+	{
+		{ 50000, 26270, 67800, 5930,
+		  12850000, 13963, 36037, 50000,
+		  12850000, 50000, 45979, 4021 },
+		{ 1650000, 22561, 58229, 5093,
+		  12850000, 12266, 31656, 43922,
+		  12850000, 43922, 40389, 3533 },
+	},
+};
+
+static unsigned int norm(long long sum, unsigned int max)
+{
+	if (sum < 0)
+		return 0;
+	sum /= LOGICVC_YUV_NORM;
+
+	return (sum > max) ? max : sum;
+}
+
+/* 8 bit level of offset is scaled to bits, rounding fraction is kept */
+static long long offset(int c, int bits)
+{
+	int fraction = c % LOGICVC_YUV_NORM;
+
+	return ((long long)(c - fraction) << (bits - 8)) + fraction;
+}
+
+static unsigned int reference(const struct coeff *c, int r, int g, int b,
+			      int bits)
+{
+	unsigned int max = (1 << bits) - 1;
+	unsigned int y, u, v;
+
+	y = norm((long long)c->cyr * r + (long long)c->cyg * g +
+		 (long long)c->cyb * b + offset(c->cy, bits), max);
+	u = norm(-(long long)c->cur * r - (long long)c->cug * g +
+		 (long long)c->cub * b + offset(c->cu, bits), max);
+	v = norm((long long)c->cvr * r - (long long)c->cvg * g -
+		 (long long)c->cvb * b + offset(c->cv, bits), max);
+
+	return (y << (2 * bits)) | (u << bits) | v;
+}
+
+static int convert(int fbfd, unsigned int offset, int r, int g, int b,
+		   unsigned int *yuv)
+{
+	struct xylonfb_layer_color color;
+	struct xylonfb_hw_access hw_access;
+
+	memset(&color, 0, sizeof(color));
+	color.r = r;
+	color.g = g;
+	color.b = b;
+	color.set = true;
+	if (ioctl(fbfd, XYLONFB_LAYER_COLOR_TRANSP, &color))
+		return -errno;
+
+	hw_access.offset = offset;
+	hw_access.set = false;
+	if (ioctl(fbfd, XYLONFB_HW_ACCESS, &hw_access))
+		return -errno;
+
+	*yuv = hw_access.value;
+
+	return 0;
+}
+
+/* Converts all colors, 8 bit components are scaled to 10 bit layers */
+static int test_coeff(int fbfd, unsigned int offset, const struct coeff *c,
+		      int bits)
+{
+	unsigned int mask = (1 << (3 * bits)) - 1;
+	unsigned int i, yuv, ref, errors = 0;
+	int r, g, b, ret;
+
+	for (i = 0; i < (1 << 24); i++) {
+		r = i >> 16;
+		g = (i >> 8) & 0xFF;
+		b = i & 0xFF;
+		r = (r << (bits - 8)) | (r >> (16 - bits));
+		g = (g << (bits - 8)) | (g >> (16 - bits));
+		b = (b << (bits - 8)) | (b >> (16 - bits));
+
+		ret = convert(fbfd, offset, r, g, b, &yuv);
+		if (ret) {
+			perror("IOCTL Error");
+			return ret;
+		}
+
+		ref = reference(c, r, g, b, bits);
+		if ((yuv & mask) == ref)
+			continue;
+		if (errors++ < 10)
+			printf("RGB %d %d %d: 0x%08X, expected 0x%08X\n",
+			       r, g, b, yuv & mask, ref);
+	}
+
+	printf("%u errors\n", errors);
+
+	return errors ? -EINVAL : 0;
+}
+
+static int test_space(int fbfd, unsigned int offset, bool itu656,
+		      int space, int range, int bits)
+{
+	struct xylonfb_color_space color_space;
+	const struct coeff *c;
+
+	color_space.space = space;
+	color_space.range = range;
+	color_space.set = true;
+	if (ioctl(fbfd, XYLONFB_COLOR_SPACE, &color_space)) {
+		perror("IOCTL Error");
+		return -errno;
+	}
+
+	if (space == XYLONFB_COLOR_SPACE_DEFAULT)
+		c = itu656 ? &coeff_itu656 : &coeff_default;
+	else
+		c = &coeff_space[space - 1][range];
+
+	printf("Color space %d range %d, %d bit: ", space, range, bits);
+	fflush(stdout);
+
+	return test_coeff(fbfd, offset, c, bits);
+}
+
+int main(int argc, char *argv[])
+{
+	struct fb_var_screeninfo vinfo;
+	struct xylonfb_color_space color_space;
+	struct xylonfb_layer_color color;
+	struct xylonfb_hw_access transp;
+	unsigned int id, offset, yuv;
+	int fbfd, bits, space, range, arg;
+	bool itu656 = false;
+	int ret = 0;
+
+	if (argc < 2) {
+		puts("Usage: yuvtest /dev/fb* [itu656] [space range]");
+		return -1;
+	}
+	arg = 2;
+	if ((argc > arg) && !strcmp(argv[arg], "itu656")) {
+		itu656 = true;
+		arg++;
+	}
+
+	fbfd = open(argv[1], O_RDWR);
+	if (fbfd < 0) {
+		printf("Error opening framebuffer device %s\n", argv[1]);
+		perror(NULL);
+		return -errno;
+	}
+
+	if (ioctl(fbfd, FBIOGET_VSCREENINFO, &vinfo) ||
+	    ioctl(fbfd, XYLONFB_LAYER_IDX, &id)) {
+		perror("IOCTL Error");
+		close(fbfd);
+		return -errno;
+	}
+
+	switch (vinfo.grayscale) {
+	case LOGICVC_PIX_FMT_YUYV_121010:
+	case LOGICVC_PIX_FMT_UYVY_121010:
+	case LOGICVC_PIX_FMT_XYUV_2101010:
+		bits = 10;
+		break;
+	default:
+		bits = 8;
+	}
+
+	offset = LOGICVC_LAYER_BASE_OFFSET + (id * LOGICVC_LAYER_OFFSET) +
+		 LOGICVC_LAYER_TRANSP_COLOR_ROFF;
+
+	color_space.set = false;
+	transp.offset = offset;
+	transp.set = false;
+	if (ioctl(fbfd, XYLONFB_COLOR_SPACE, &color_space) ||
+	    ioctl(fbfd, XYLONFB_HW_ACCESS, &transp)) {
+		perror("IOCTL Error");
+		close(fbfd);
+		return -errno;
+	}
+
+	/* RGB background layer: black is not converted to YUV black */
+	if (convert(fbfd, offset, 0, 0, 0, &yuv) ||
+	    !(yuv & ((1 << (2 * bits)) - 1))) {
+		puts("Layer colors are not converted to YUV");
+		ret = -EINVAL;
+		goto restore;
+	}
+
+	if ((argc - arg) >= 2) {
+		space = strtol(argv[arg], 0, 0);
+		range = strtol(argv[arg + 1], 0, 0);
+		ret = test_space(fbfd, offset, itu656, space, range, bits);
+		goto restore;
+	}
+
+	ret = test_space(fbfd, offset, itu656, XYLONFB_COLOR_SPACE_DEFAULT,
+			 XYLONFB_COLOR_RANGE_FULL, bits);
+	for (space = XYLONFB_COLOR_SPACE_BT601;
+	     space <= XYLONFB_COLOR_SPACE_BT2020; space++)
+		for (range = XYLONFB_COLOR_RANGE_FULL;
+		     range <= XYLONFB_COLOR_RANGE_LIMITED; range++)
+			if (test_space(fbfd, offset, itu656, space, range,
+				       bits))
+				ret = -EINVAL;
+
+restore:
+	color_space.set = true;
+	memset(&color, 0, sizeof(color));
+	color.raw_rgb = transp.value;
+	color.use_raw = 1;
+	color.set = true;
+	if (ioctl(fbfd, XYLONFB_COLOR_SPACE, &color_space) ||
+	    ioctl(fbfd, XYLONFB_LAYER_COLOR_TRANSP, &color))
+		perror("IOCTL Error");
+
+	close(fbfd);
+
+	puts(ret ? "FAILED" : "PASSED");
+
+	return ret;
+}